@@ -32,6 +32,22 @@
 	if (pad < 0 || pad >= nn)
 		return -1;
 
+	if (rs->split_gen) {
+		uint8_t *lo, *hi;
+
+		for (i = 0; i < len; i++) {
+			/* feedback term in polynomial form */
+			fb = ((((uint16_t) data[i])^invmsk) & msk) ^ par[0];
+			lo = rs->split_gen + (fb & 0xf) * nroots;
+			hi = rs->split_gen + (16 + (fb >> 4)) * nroots;
+			/* Shift and add the feedback times genpoly[] */
+			for (j = 0; j < nroots - 1; j++)
+				par[j] = par[j + 1] ^ lo[j] ^ hi[j];
+			par[nroots - 1] = lo[nroots - 1] ^ hi[nroots - 1];
+		}
+		return 0;
+	}
+
 	for (i = 0; i < len; i++) {
 		fb = index_of[((((uint16_t) data[i])^invmsk) & msk) ^ par[0]];
 		/* feedback term is non-zero */
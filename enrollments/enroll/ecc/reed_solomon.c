@@ -65,6 +65,42 @@ static pthread_mutex_t rslistlock;
 
 /* static DEFINE_MUTEX(rslistlock); */
 
+/* Product of a and b, both in polynomial form */
+static uint8_t rs_split_mul(struct rs_control *rs, int a, int b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	return rs->alpha_to[rs_modnn(rs, rs->index_of[a] + rs->index_of[b])];
+}
+
+/**
+ * split_init - Fill the split nibble tables of the encoder
+ * @rs:	the rs control structure, with 8 bit symbols
+ *
+ * The product of a constant c and a symbol x is lo[x & 0xf] ^ hi[x >> 4],
+ * where lo and hi hold the multiples of c by the 16 low and the 16 high
+ * nibbles. Two loads and a xor replace the log / antilog lookups, the
+ * modulo reduction and the zero test of the generic encoder.
+ *
+ * The [32][nroots] tables are indexed by the nibble, row i holding the
+ * multiples of genpoly[nroots - 1 - i], so that a feedback term updates
+ * all parity symbols with two rows.
+ */
+static void split_init(struct rs_control *rs)
+{
+	int nroots = rs->nroots;
+	int i, n, c;
+
+	for (i = 0; i < nroots; i++) {
+		c = rs->alpha_to[rs->genpoly[nroots - 1 - i]];
+		for (n = 0; n < 16; n++) {
+			rs->split_gen[n * nroots + i] = rs_split_mul(rs, c, n);
+			rs->split_gen[(16 + n) * nroots + i] =
+				rs_split_mul(rs, c, n << 4);
+		}
+	}
+}
+
 /**
  * rs_init - Initialize a Reed-Solomon codec
  * @symsize:	symbol size, bits (1-8)
@@ -97,6 +133,7 @@ static struct rs_control *rs_init(int symsize, int gfpoly, int (*gffunc)(int),
 	rs->nroots = nroots;
 	rs->gfpoly = gfpoly;
 	rs->gffunc = gffunc;
+	rs->split_gen = NULL;
 
 	/* Allocate the arrays */
 	rs->alpha_to = malloc(sizeof(uint16_t) * (rs->nn + 1));
@@ -162,10 +199,19 @@ static struct rs_control *rs_init(int symsize, int gfpoly, int (*gffunc)(int),
 	/* convert rs->genpoly[] to index form for quicker encoding */
 	for (i = 0; i <= nroots; i++)
 		rs->genpoly[i] = rs->index_of[rs->genpoly[i]];
+
+	/* 8 bit symbols are encoded with the split nibble tables */
+	if (symsize == 8 && nroots > 0) {
+		rs->split_gen = malloc(2 * 16 * nroots);
+		if (rs->split_gen == NULL)
+			goto errpol;
+		split_init(rs);
+	}
 	return rs;
 
 	/* Error exit */
 errpol:
+	free(rs->split_gen);
 	free(rs->genpoly);
 erridx:
 	free(rs->index_of);
@@ -191,6 +237,7 @@ void free_rs(struct rs_control *rs)
 		free(rs->alpha_to);
 		free(rs->index_of);
 		free(rs->genpoly);
+		free(rs->split_gen);
 		free(rs);
 	}
 	mutex_unlock(&rslistlock);
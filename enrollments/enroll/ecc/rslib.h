@@ -38,6 +38,8 @@
  * @gffunc:	Function to generate the field, if non-canonical representation
  * @users:	Users of this structure
  * @list:	List entry for the rs control list
+ * @split_gen:	Split nibble multiples of the generator polynomial, 8 bit
+ *		symbols only, NULL otherwise (see rs_init)
 */
 struct rs_control {
 	int 		mm;
@@ -53,6 +55,7 @@ struct rs_control {
 	int		(*gffunc)(int);
 	int		users;
 	struct list_head list;
+	uint8_t		*split_gen;
 };
 
 /* General purpose RS codec, 8-bit data width, symbol width 1-15 bit  */
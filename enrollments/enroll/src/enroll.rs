@@ -1,4 +1,4 @@
-use crate::{reed_solomon, Config};
+use crate::{reed_solomon, Config, Ecc};
 use serde::{Deserialize, Serialize};
 
 use rand::distributions::{Distribution, Uniform};
@@ -8,6 +8,9 @@ use rand_chacha::ChaCha8Rng;
 
 pub type DRAMCells = Vec<Vec<u32>>;
 
+/// Parity symbols a record may carry, see PUF_MAX_PARITY of the puf kernel module.
+const MAX_PARITY: usize = 32;
+
 #[derive(Serialize, Deserialize, Debug)]
 pub struct Enrollment {
     #[serde(rename = "decay_time")]
@@ -66,19 +69,26 @@ pub fn prepare(
                 }
             }
 
-            let mut data = [0u8; AUTH_VALUE_SIZE];
-            for i in 0..AUTH_VALUE_SIZE {
-                let bit = (auth_value >> ((AUTH_VALUE_SIZE - 1) - i)) & 0x1;
-                if bit != 0x0 {
-                    data[i] = 1;
-                }
-            }
+            // one symbol per bit, or the bytes of the response if packed.
+            let mut data = match cfg.enrollment.ecc {
+                Ecc::Bits => (0..AUTH_VALUE_SIZE)
+                    .map(|i| ((auth_value >> ((AUTH_VALUE_SIZE - 1) - i)) & 0x1) as u8)
+                    .collect::<Vec<u8>>(),
+                Ecc::Packed => auth_value.to_be_bytes().to_vec(),
+            };
 
             let mut parity = vec![
                 0u16;
-                (AUTH_VALUE_SIZE as f64 * (cfg.enrollment.parity_percentage as f64 / 100.))
-                    as usize
+                (cfg.enrollment.ecc.data_symbols() as f64 * (cfg.enrollment.parity_percentage as f64 / 100.)) as usize
             ];
+            if parity.is_empty() || parity.len() > MAX_PARITY {
+                return Err(format!(
+                    "parity_percentage {} gives {} parity symbols, the kernel module accepts 1 to {}",
+                    cfg.enrollment.parity_percentage,
+                    parity.len(),
+                    MAX_PARITY
+                ))?;
+            }
 
             let control_ptr = reed_solomon::init(&parity);
             if control_ptr.is_null() {
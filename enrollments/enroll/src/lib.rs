@@ -6,6 +6,7 @@ use enroll::DRAMCells;
 use crate::enroll::Enrollment;
 use std::fs::File;
 use std::io::Read;
+use std::ops::Range;
 use std::path::PathBuf;
 use std::{env, fs, u64};
 
@@ -62,6 +63,55 @@ impl WordSize {
     }
 }
 
+#[derive(serde::Serialize, serde::Deserialize, Debug, Default, Clone, Copy)]
+pub enum TimeUnit {
+    #[default]
+    #[serde(rename = "s")]
+    Seconds,
+    #[serde(rename = "ms")]
+    Milliseconds,
+}
+
+impl TimeUnit {
+    fn as_str(&self) -> &'static str {
+        match self {
+            TimeUnit::Seconds => "s",
+            TimeUnit::Milliseconds => "ms",
+        }
+    }
+
+    /// Suffix of the measurement files taken with the given unit.
+    /// (i.e. BBB_1_20sec or BBB_1_250ms)
+    fn file_suffix(&self) -> &'static str {
+        match self {
+            TimeUnit::Seconds => "sec",
+            TimeUnit::Milliseconds => "ms",
+        }
+    }
+}
+
+/// Error correcting code protecting the responses.
+#[derive(serde::Serialize, serde::Deserialize, Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub enum Ecc {
+    /// Reed Solomon over the 32 response bits, one 8bit symbol per bit.
+    #[default]
+    #[serde(rename = "bits")]
+    Bits,
+    /// Reed Solomon over the 4 bytes of the response, 8bit parity.
+    #[serde(rename = "packed")]
+    Packed,
+}
+
+impl Ecc {
+    /// Number of data symbols the parity protects.
+    pub(crate) fn data_symbols(&self) -> usize {
+        match self {
+            Ecc::Bits => 32,
+            Ecc::Packed => 4,
+        }
+    }
+}
+
 #[derive(serde::Serialize, serde::Deserialize, Debug)]
 pub struct DecayConfig {
     /// Lowest timeout of the datasets.
@@ -75,6 +125,20 @@ pub struct DecayConfig {
     /// Number of measurements taken for the same timeout.
     /// (i.e 10s, 20s, 30s, 10s, 20s, 30s, would be 2)
     pub replication: i32,
+    /// Unit of the timeouts above, either "s" or "ms".
+    /// (i.e. decay_time_start = 250 with unit "ms" is a 250ms timeout)
+    #[serde(default)]
+    pub unit: TimeUnit,
+    /// Temperature the measurements were taken at, as the DTEMP code of the
+    /// bandgap sensor logged by the plain_puf kernel module ("Temp Avg").
+    /// The puf kernel module scales the decay times by the temperature
+    /// difference to it when set.
+    #[serde(default)]
+    pub temperature: Option<u8>,
+    /// DTEMP codes of temperature rise halving the retention of the cells,
+    /// the retention_halving of the puf kernel module is used if not set.
+    #[serde(default)]
+    pub retention_halving: Option<u8>,
 }
 
 impl DecayConfig {
@@ -83,6 +147,14 @@ impl DecayConfig {
     }
 }
 
+#[derive(serde::Serialize, serde::Deserialize, Debug)]
+pub struct SlotConfig {
+    /// Index of the slot the enrollment is generated for.
+    pub index: usize,
+    /// Number of slots the PUF is split into (puf_slots of the kernel module).
+    pub count: usize,
+}
+
 #[derive(serde::Serialize, serde::Deserialize, Debug)]
 pub struct PUFConfig {
     /// Size of the PUF in the measurements.
@@ -96,6 +168,10 @@ pub struct PUFConfig {
     /// bus width in bits of the SDRAM.
     /// (i.e. on the BeagleBone Black rev 3C its 16 bits)
     pub bus_width: WordSize,
+    /// If the kernel module splits the PUF into multiple slots, the slot
+    /// the enrollment is generated for. Only the cells of the slot are used.
+    #[serde(default)]
+    pub slot: Option<SlotConfig>,
 }
 
 impl PUFConfig {
@@ -111,14 +187,36 @@ impl PUFConfig {
     fn num_of_rows(&self) -> usize {
         self.size_in_bytes() / self.row_width()
     }
+    /// Rows the cells can be picked from, all of them unless a slot is configured.
+    fn slot_rows(&self) -> Result<Range<usize>, Box<dyn std::error::Error>> {
+        match &self.slot {
+            None => Ok(0..self.num_of_rows()),
+            Some(slot) => {
+                if slot.count == 0 || slot.index >= slot.count || self.num_of_rows() % slot.count != 0 {
+                    return Err(format!(
+                        "slot {} of {} does not split the {} rows of the PUF evenly",
+                        slot.index,
+                        slot.count,
+                        self.num_of_rows()
+                    ))?;
+                }
+                let rows = self.num_of_rows() / slot.count;
+                Ok(slot.index * rows..(slot.index + 1) * rows)
+            }
+        }
+    }
 }
 
 #[derive(serde::Serialize, serde::Deserialize, Debug)]
 pub struct EnrollmentConfig {
     /// Name of the output file.
     pub name: String,
-    /// Recover % of the original message
+    /// Recover % of the original message, i.e. the number of parity symbols
+    /// relative to the data symbols of the code.
     pub parity_percentage: usize,
+    /// Code protecting the responses, either "bits" or "packed".
+    #[serde(default)]
+    pub ecc: Ecc,
 }
 
 #[derive(serde::Serialize, serde::Deserialize, Debug)]
@@ -159,6 +257,15 @@ struct EnrollData {
     requests: Vec<u32>,
     // if not zero add additional delay to when the PUF requests will be performed.
     read_with_delay: u32,
+    // unit of the requests, decay times and delay.
+    time_unit: TimeUnit,
+    // code the parity of the enrollments was computed with.
+    ecc: Ecc,
+    // reference temperature of the decay times, see DecayConfig.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    temperature: Option<u8>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    retention_halving: Option<u8>,
     enrollments: Vec<Enrollment>,
 }
 
@@ -170,8 +277,9 @@ pub fn generate(cfg: &Config) -> Result<(), Box<dyn std::error::Error>> {
         let unstable_cells_count = measurement.1.iter().map(|row| row.len()).sum::<usize>();
         let stable_0_cells_count = measurement.2.iter().map(|row| row.len()).sum::<usize>();
         println!(
-            "Stats related to \"Decay Timeout: {}s\"",
-            cfg.decay_config.get_measurement(i)
+            "Stats related to \"Decay Timeout: {}{}\"",
+            cfg.decay_config.get_measurement(i),
+            cfg.decay_config.unit.as_str()
         );
         println!("\t stable_cells(common to all measurements, not present in previous decay timeout): {}", stable_cells_count);
         println!(
@@ -204,6 +312,10 @@ pub fn generate(cfg: &Config) -> Result<(), Box<dyn std::error::Error>> {
             })
             .collect(),
         read_with_delay: 0,
+        time_unit: cfg.decay_config.unit,
+        ecc: cfg.enrollment.ecc,
+        temperature: cfg.decay_config.temperature,
+        retention_halving: cfg.decay_config.retention_halving,
     };
 
     let output_file = File::create(&cfg.enrollment.name)?;
@@ -259,6 +371,8 @@ fn collect_next_word(
 fn extract_cells(
     cfg: &Config,
 ) -> Result<Vec<(DRAMCells, DRAMCells, DRAMCells)>, Box<dyn std::error::Error>> {
+    let slot_rows = cfg.puf_config.slot_rows()?;
+
     measurements(cfg)?
         .iter_mut()
         .map(|pair| {
@@ -320,6 +434,13 @@ fn extract_cells(
                         })
                 }
             }
+            // drop the cells outside of the slot, the whole measurement
+            // still has to be read as the files are read sequentially.
+            for row in (0..cfg.puf_config.num_of_rows()).filter(|row| !slot_rows.contains(row)) {
+                stable_1_cells[row].clear();
+                stable_0_cells[row].clear();
+                unstable_cells[row].clear();
+            }
             Ok((stable_1_cells, unstable_cells, stable_0_cells))
         })
         .collect()
@@ -333,7 +454,13 @@ fn collect_measurements(
 
     for iter in 1..=cfg.decay_config.replication {
         let path =
-            PathBuf::from(&cfg.path).join(format!("{}_{}_{}sec", cfg.common_prefix, iter, timeout));
+            PathBuf::from(&cfg.path).join(format!(
+                "{}_{}_{}{}",
+                cfg.common_prefix,
+                iter,
+                timeout,
+                cfg.decay_config.unit.file_suffix()
+            ));
         current_measurements.push(File::open(path)?);
     }
 
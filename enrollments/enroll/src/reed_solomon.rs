@@ -38,6 +38,8 @@ pub struct C_RsControl {
     users: c_int,
     /// @list: List entry for the rs control list
     list: ListHead,
+    /// @split_gen: Split nibble multiples of the generator polynomial, 8 bit symbols only
+    split_gen: *mut u8,
 }
 
 extern "C" {
@@ -3,13 +3,17 @@
 replication=4
 puf_start_address=0x84c00000
 puf_size=4194304
+unit=sec # "sec" or "ms", use "ms" together with "unit": "ms" in the decay_config of the JSON config.
 
 echo "starting measurements"
 #for num in 20 30 40 50; do # (this would equal to 4 measurements)
 for num in 50; do # "num_of_measurements (used in the JSON config, i.e. this would equal to 1)
     sleep_seconds=$num
+    if [ "$unit" = "ms" ]; then
+        sleep_seconds=$(printf '%d.%03d' $((num / 1000)) $((num % 1000)))
+    fi
 
-    folder_name="./${sleep_seconds}s"
+    folder_name="./${num}${unit}"
     mkdir -p "$folder_name"
 
     for ((i=1; i<=$replication; i++)); do
@@ -21,7 +25,7 @@ for num in 50; do # "num_of_measurements (used in the JSON config, i.e. this wou
         sleep ${sleep_seconds}
         ssh -q root@beaglebone.local rmmod dram_puf
 
-        ssh -q root@beaglebone.local cat /dev/puf_block_1 >  "${folder_name}/BBB_${iter}_${num}sec"
+        ssh -q root@beaglebone.local cat /dev/puf_block_1 >  "${folder_name}/BBB_${iter}_${num}${unit}"
         echo "Done with Iteration $iter!"
         echo "wait 8 mins before next iteration"
         sleep 480
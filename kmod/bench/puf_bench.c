@@ -0,0 +1,659 @@
+// Userspace benchmark of the portable PUF core, built against backend_user.h.
+//
+// Measures the throughput of the Reed Solomon codec, the split nibble tables against
+// the generic log / antilog kernels (rs_generic.c), the read path of a decay window
+// (cell loads, Reed Solomon correction, packing of the response) on a synthetic PUF
+// region and the cost of a software refresh pass over an ordinary buffer with the
+// PUF region excluded. The fixed point retention model is checked against pow() over
+// the range of the temperature sensor, the end of the warm up is run against a
+// simulated decay of a warming up device and the slot of an enrollment is checked
+// the way the module binds it.
+//
+// usage: puf_bench [iterations] [refresh-region-mb]
+
+#define CONFIG_REED_SOLOMON_ENC8
+#define CONFIG_REED_SOLOMON_DEC8
+#define CONFIG_REED_SOLOMON_SPLIT8
+#include "ecc/reed_solomon.c"
+
+#include "puf_core.h"
+#include "refresh.h"
+#include "retention.h"
+#include "warm_up.h"
+
+#include <math.h>
+
+#define BENCH_PUF_SIZE          (1 << 20)                     // Size of the synthetic PUF region.
+#define BENCH_ROW_SIZE          (2 * (1<<10))                 // bus_width * page_size, as on the BeagleBone.
+#define BENCH_REFRESH_PASSES    64                            // Number of measured refresh passes.
+#define BENCH_DTEMP_CODES       256                           // Codes of the 8bit DTEMP field of the bandgap sensor.
+#define BENCH_WARM_UP_BLOCKS    256                           // 16bit blocks of the simulated warm up region.
+#define BENCH_WARM_UP_TRIALS    1000                          // Simulated warm ups per scenario.
+#define BENCH_WARM_UP_CYCLES    4                             // warmup_max_cycles, the module default.
+#define BENCH_SLOT_WINDOWS      8                             // Windows of each enrollment of the slot check.
+#define BENCH_SLOT_PATTERN      0xa5                          // Fill of the region around a started slot.
+
+// parity symbols over the 32 response bits, or over the 4 response bytes if packed.
+static const struct {
+    uint32_t parity;
+    bool     packed;
+} codes[] = { { 4, false }, { 8, false }, { 16, false }, { 32, false }, { 2, true }, { 4, true }, { 8, true } };
+
+// rs_generic.c, the codec without CONFIG_REED_SOLOMON_SPLIT8.
+struct rs_control *generic_init_rs_gfp(int symsize, int gfpoly, int fcr, int prim, int nroots, gfp_t gfp);
+void generic_free_rs(struct rs_control *rs);
+int generic_encode_rs8(struct rs_control *rs, uint8_t *data, int len, uint16_t *par, uint16_t invmsk);
+int generic_decode_rs8(struct rs_control *rs, uint8_t *data, uint16_t *par, int len, uint16_t *s, int no_eras,
+                       int *eras_pos, uint16_t invmsk, uint16_t *corr);
+
+static const struct {
+    const char *name;
+    struct rs_control *(*init)(int symsize, int gfpoly, int fcr, int prim, int nroots, gfp_t gfp);
+    void (*free)(struct rs_control *rs);
+    int (*encode)(struct rs_control *rs, uint8_t *data, int len, uint16_t *par, uint16_t invmsk);
+    int (*decode)(struct rs_control *rs, uint8_t *data, uint16_t *par, int len, uint16_t *s, int no_eras,
+                  int *eras_pos, uint16_t invmsk, uint16_t *corr);
+} codecs[] = {
+    { "split",   init_rs_gfp,         free_rs,         encode_rs8,         decode_rs8 },
+    { "generic", generic_init_rs_gfp, generic_free_rs, generic_encode_rs8, generic_decode_rs8 },
+};
+
+struct bench_stats {
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+};
+
+static void stats_add(struct bench_stats *s, uint64_t ns) {
+    s->total_ns += ns;
+    if (s->min_ns == 0 || ns < s->min_ns) {
+        s->min_ns = ns;
+    }
+    if (ns > s->max_ns) {
+        s->max_ns = ns;
+    }
+}
+
+static void put_be(uint8_t **out, uint32_t value, uint32_t bytes) {
+    while (bytes-- > 0) {
+        *(*out)++ = value >> (bytes * 8);
+    }
+}
+
+// Enrolls a window of random cells of the region, serialized the way the enroll
+// tool does, and flips `errors` of its cells afterwards so that the read path has
+// to correct them. Returns the size of the enrollment.
+static uint32_t enroll_window(uint8_t *region, struct rs_control *rs, uint32_t parity, bool packed,
+                              uint32_t errors, uint8_t *enrollment, uint32_t *expected) {
+    uint32_t cells[32];
+    uint8_t  bits[32];
+    uint8_t  bytes[4];
+    uint16_t par[PUF_MAX_PARITY] = {0};
+    uint8_t *out = enrollment;
+    uint32_t i, block, mask;
+
+    for (i = 0; i < 32; i++) {
+        block = rand() % (BENCH_PUF_SIZE / sizeof(uint16_t));
+        mask = rand() % 16;
+        cells[i] = (block << 4) | mask;
+        bits[i] = (puf_be_r16_be(region + block * sizeof(uint16_t)) >> mask) & 0x1;
+    }
+    *expected = puf_bits_to_response(bits);
+    if (packed) {
+        for (i = 0; i < 4; i++) {
+            bytes[i] = *expected >> (24 - i * 8);
+        }
+        encode_rs8(rs, bytes, 4, par, 0);
+    } else {
+        encode_rs8(rs, bits, 32, par, 0);
+    }
+
+    put_be(&out, PUF_ENROLLMENT_VERSION, 1);
+    put_be(&out, packed ? PUF_SET_FLAG_PACKED : 0, 1);
+    put_be(&out, 1, 2);
+    put_be(&out, 1000, 4);
+    put_be(&out, parity, 1);
+    for (i = 0; i < parity; i++) {
+        put_be(&out, par[i], packed ? 1 : 2);
+    }
+    for (i = 0; i < 32; i++) {
+        put_be(&out, cells[i], 4);
+    }
+
+    // the region is big endian, bit mask of the 16bit block.
+    for (i = 0; i < errors; i++) {
+        block = cells[i] >> 4;
+        mask = cells[i] & 0xf;
+        region[block * sizeof(uint16_t) + (mask < 8 ? 1 : 0)] ^= 1 << (mask % 8);
+    }
+    return out - enrollment;
+}
+
+// Times encoding, the syndromes of an intact codeword (decoding without errors) and
+// the correction of parity / 2 symbol errors with each codec, per codeword.
+static int bench_codec(uint32_t iterations) {
+    uint8_t  data[32], received[32];
+    uint16_t par[PUF_MAX_PARITY], expected[PUF_MAX_PARITY], received_par[PUF_MAX_PARITY];
+    uint32_t len, p, c, e, i;
+    uint64_t start, encode_ns, syndrome_ns, correct_ns;
+    int      corrected = 0;
+    struct rs_control *rs;
+
+    printf("codec, %u iterations\n", iterations);
+    printf("%8s %8s %8s %12s %12s %12s %12s\n", "code", "parity", "codec", "encode ns", "syndrome ns",
+           "correct ns", "encode MB/s");
+
+    for (p = 0; p < sizeof(codes) / sizeof(codes[0]); p++) {
+        len = codes[p].packed ? 4 : 32;
+        for (i = 0; i < len; i++) {
+            data[i] = codes[p].packed ? rand() : rand() & 0x1;
+        }
+
+        for (c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+            rs = codecs[c].init(8, 0x11d, 0, 1, codes[p].parity, GFP_KERNEL); // same params as the module.
+            if (!rs) {
+                fprintf(stderr, "%s init_rs(%u) failed\n", codecs[c].name, codes[p].parity);
+                return -1;
+            }
+
+            start = puf_be_now_ns();
+            for (i = 0; i < iterations; i++) {
+                memset(par, 0, sizeof(par));
+                codecs[c].encode(rs, data, len, par, 0);
+            }
+            encode_ns = puf_be_now_ns() - start;
+            // both codecs have to agree on the parity.
+            if (c == 0) {
+                memcpy(expected, par, sizeof(par));
+            } else if (memcmp(expected, par, codes[p].parity * sizeof(uint16_t)) != 0) {
+                fprintf(stderr, "%s parity %u: parity differs from %s\n", codecs[c].name, codes[p].parity,
+                        codecs[0].name);
+                return -1;
+            }
+
+            start = puf_be_now_ns();
+            for (i = 0; i < iterations; i++) {
+                memcpy(received_par, par, sizeof(par));
+                corrected = codecs[c].decode(rs, data, received_par, len, NULL, 0, NULL, 0, NULL);
+            }
+            syndrome_ns = puf_be_now_ns() - start;
+            if (corrected != 0) {
+                fprintf(stderr, "%s parity %u: intact codeword decoded to %d\n", codecs[c].name,
+                        codes[p].parity, corrected);
+                return -1;
+            }
+
+            start = puf_be_now_ns();
+            for (i = 0; i < iterations; i++) {
+                memcpy(received, data, len);
+                memcpy(received_par, par, sizeof(par));
+                for (e = 0; e < codes[p].parity / 2; e++) {
+                    received[e] ^= 0x1;
+                }
+                corrected = codecs[c].decode(rs, received, received_par, len, NULL, 0, NULL, 0, NULL);
+            }
+            correct_ns = puf_be_now_ns() - start;
+            if (corrected != (int) codes[p].parity / 2 || memcmp(received, data, len) != 0) {
+                fprintf(stderr, "%s parity %u: failed to correct %u errors (corrected %d)\n", codecs[c].name,
+                        codes[p].parity, codes[p].parity / 2, corrected);
+                return -1;
+            }
+
+            printf("%8s %8u %8s %12llu %12llu %12llu %12.1f\n", codes[p].packed ? "packed" : "bits",
+                   codes[p].parity, codecs[c].name, (unsigned long long) encode_ns / iterations,
+                   (unsigned long long) syndrome_ns / iterations, (unsigned long long) correct_ns / iterations,
+                   encode_ns ? (double) len * iterations * 1000 / encode_ns : 0.0);
+            codecs[c].free(rs);
+        }
+    }
+    return 0;
+}
+
+static int bench_read_path(uint8_t *region, uint32_t iterations) {
+    uint8_t  enrollment[PUF_SET_HEADER_SIZE + 5 + PUF_MAX_PARITY * 2 + 32 * 4];
+    uint8_t  bits[32];
+    uint32_t count, ptr, expected, p, i;
+    uint32_t response  = 0x0;
+    uint64_t start, cells_ns;
+    int      corrected = 0;
+    struct puf_set     set;
+    struct puf_record  record;
+    struct rs_control *rs;
+    struct bench_stats stats;
+
+    printf("read path, %u iterations\n", iterations);
+    printf("%8s %8s %8s %12s %12s %12s %12s\n", "code", "parity", "symbols", "cells ns", "avg ns", "min ns", "max ns");
+
+    for (p = 0; p < sizeof(codes) / sizeof(codes[0]); p++) {
+        rs = init_rs(8, 0x11d, 0, 1, codes[p].parity); // same params as the module.
+        if (!rs) {
+            fprintf(stderr, "init_rs(%u) failed\n", codes[p].parity);
+            return -1;
+        }
+
+        // errors in consecutive response bits, the same byte for packed codes.
+        count = enroll_window(region, rs, codes[p].parity, codes[p].packed, codes[p].parity / 2, enrollment,
+                              &expected);
+        ptr = 0;
+        if (puf_parse_set(enrollment, count, &ptr, &set) != 0 || puf_record_size(enrollment, count, ptr, &set) == 0) {
+            fprintf(stderr, "failed to parse the synthetic enrollment\n");
+            return -1;
+        }
+        puf_decode_record(enrollment, &ptr, &set, &record);
+
+        start = puf_be_now_ns();
+        for (i = 0; i < iterations; i++) {
+            puf_read_cells(&record, region, bits);
+        }
+        cells_ns = (puf_be_now_ns() - start) / iterations;
+
+        stats = (struct bench_stats) {0};
+        for (i = 0; i < iterations; i++) {
+            start = puf_be_now_ns();
+            puf_read_cells(&record, region, bits);
+            corrected = puf_correct(rs, &record, bits);
+            response = puf_bits_to_response(bits);
+            stats_add(&stats, puf_be_now_ns() - start);
+        }
+
+        if (corrected < 0 || response != expected) {
+            fprintf(stderr, "parity %u: got 0x%08x expected 0x%08x (corrected %d)\n",
+                    codes[p].parity, response, expected, corrected);
+            return -1;
+        }
+        printf("%8s %8u %8d %12llu %12llu %12llu %12llu\n", codes[p].packed ? "packed" : "bits", codes[p].parity,
+               corrected, (unsigned long long) cells_ns,
+               (unsigned long long) (stats.total_ns / iterations), (unsigned long long) stats.min_ns,
+               (unsigned long long) stats.max_ns);
+        free_rs(rs);
+    }
+    return 0;
+}
+
+// Rows of the region overlapping none of the excluded ranges, counted row by row
+// against every range, independently of the walk of the engine.
+static uint32_t refresh_expected_rows(uint32_t size, const struct refresh_range *excluded, uint32_t count) {
+    uint32_t row, i, addr;
+    uint32_t rows = 0;
+
+    for (row = 0; row < size / BENCH_ROW_SIZE; row++) {
+        addr = row * BENCH_ROW_SIZE;
+        for (i = 0; i < count; i++) {
+            if (excluded[i].beg < addr + BENCH_ROW_SIZE && excluded[i].end > addr) {
+                break;
+            }
+        }
+        rows += i == count;
+    }
+
+    return rows;
+}
+
+// Runs the refresh over the region with the PUF region in the middle and a few other
+// ranges excluded, given unsorted, a pass split into several numbers of chunks. Every
+// pass has to touch exactly the rows outside of the excluded ranges.
+static int bench_refresh(uint32_t region_mb) {
+    static const uint32_t chunks[] = { 1, 3, 8 };
+    struct refresh_engine engine;
+    struct refresh_range  excluded[4];
+    uint32_t size = region_mb << 20;
+    uint32_t i, c, expected;
+    uint8_t *region;
+
+    region = malloc(size);
+    if (!region) {
+        fprintf(stderr, "failed to allocate %u MB\n", region_mb);
+        return -1;
+    }
+    // fault the pages in, the first pass would measure the page faults otherwise.
+    memset(region, 0, size);
+
+    // physical ranges relative to base 0: the PUF region in the middle, a range
+    // within the last row, the first row and a range covering parts of two rows.
+    excluded[0].beg = (size / 2) / BENCH_ROW_SIZE * BENCH_ROW_SIZE;
+    excluded[0].end = excluded[0].beg + BENCH_PUF_SIZE;
+    excluded[1].beg = size - BENCH_ROW_SIZE / 2;
+    excluded[1].end = size - BENCH_ROW_SIZE / 4;
+    excluded[2].beg = 0;
+    excluded[2].end = BENCH_ROW_SIZE;
+    excluded[3].beg = size / 4 + BENCH_ROW_SIZE / 2;
+    excluded[3].end = excluded[3].beg + BENCH_ROW_SIZE;
+    refresh_sort_excluded(excluded, 4);
+    expected = refresh_expected_rows(size, excluded, 4);
+
+    printf("refresh, %u MB, %u passes\n", region_mb, BENCH_REFRESH_PASSES);
+    printf("%8s %12s %12s %12s %12s\n", "chunks", "rows", "last us", "max us", "ns/row");
+    for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        refresh_init(&engine, 0, size, region, BENCH_ROW_SIZE, excluded, 4);
+        engine.chunks = chunks[c];
+
+        for (i = 0; i < BENCH_REFRESH_PASSES; i++) {
+            refresh_pass(&engine);
+            if (engine.last_rows != expected) {
+                fprintf(stderr, "%u chunks: pass %u refreshed %u rows, expected %u\n", chunks[c], i,
+                        engine.last_rows, expected);
+                free(region);
+                return -1;
+            }
+        }
+
+        printf("%8u %12u %12llu %12llu %12llu\n", chunks[c], engine.last_rows,
+               (unsigned long long) engine.last_busy_ns / 1000, (unsigned long long) engine.max_busy_ns / 1000,
+               (unsigned long long) engine.last_busy_ns / (engine.last_rows ? engine.last_rows : 1));
+    }
+
+    free(region);
+    return 0;
+}
+
+// Exact decay time of the model, clamped the same way as retention_scale_ms.
+static double retention_exact_ms(uint32_t decay_ms, int32_t temperature, int32_t reference, uint32_t halving) {
+    double exponent = (double) (reference - temperature) / halving;
+
+    exponent = fmin(fmax(exponent, -RETENTION_MAX_HALVINGS), RETENTION_MAX_HALVINGS);
+    return decay_ms * pow(2.0, exponent);
+}
+
+// Checks retention_exp2_frac over its whole domain and retention_scale_ms over every
+// DTEMP code against pow(), allowing the 0.5% of the polynomial plus the truncation
+// to whole milliseconds, and times the fixed point scaling against pow(). The reported
+// error leaves out windows scaled below a second, where the truncation dominates it.
+static int bench_retention(uint32_t iterations) {
+    static const uint32_t halvings[] = { 1, 5, 10, 20, 40 };
+    static const int32_t  references[] = { 0, 64, 128, 192, 255 };
+    static const uint32_t decays_ms[] = { 1, 100, 1000, 60000, 3600000 };
+    uint32_t h, r, d, x, i;
+    int32_t  t;
+    uint32_t scaled;
+    double   exact, error, frac_error = 0.0, max_error;
+    volatile uint32_t sink;
+    uint64_t start, fixed_ns, pow_ns;
+
+    for (x = 0; x < 65536; x++) {
+        exact = pow(2.0, x / 65536.0) * 65536;
+        frac_error = fmax(frac_error, fabs(retention_exp2_frac(x) - exact) / exact);
+    }
+    if (retention_exp2_frac(0) != 65536 || frac_error > 0.005) {
+        fprintf(stderr, "retention_exp2_frac is off by %.3f%%\n", frac_error * 100);
+        return -1;
+    }
+
+    printf("retention, DTEMP codes 0..%u, exp2 fraction max err %.3f%%\n", BENCH_DTEMP_CODES - 1, frac_error * 100);
+    printf("%8s %12s\n", "halving", "max err %");
+
+    for (h = 0; h < sizeof(halvings) / sizeof(halvings[0]); h++) {
+        max_error = 0.0;
+        for (r = 0; r < sizeof(references) / sizeof(references[0]); r++) {
+            for (d = 0; d < sizeof(decays_ms) / sizeof(decays_ms[0]); d++) {
+                for (t = 0; t < BENCH_DTEMP_CODES; t++) {
+                    scaled = retention_scale_ms(decays_ms[d], t, references[r], halvings[h]);
+                    exact = retention_exact_ms(decays_ms[d], t, references[r], halvings[h]);
+                    error = fabs(scaled - exact);
+                    // windows scaled below a millisecond stay at 1 ms.
+                    if (error > exact * 0.005 + 1.0) {
+                        fprintf(stderr, "halving %u reference %d temperature %d: %u ms scaled to %u ms, "
+                                "expected %.1f ms\n", halvings[h], references[r], t, decays_ms[d], scaled, exact);
+                        return -1;
+                    }
+                    if (exact >= 1000.0) {
+                        max_error = fmax(max_error, error / exact);
+                    }
+                }
+            }
+        }
+        printf("%8u %12.3f\n", halvings[h], max_error * 100);
+    }
+
+    start = puf_be_now_ns();
+    for (i = 0; i < iterations; i++) {
+        sink = retention_scale_ms(60000, i % BENCH_DTEMP_CODES, 128, 10);
+    }
+    fixed_ns = puf_be_now_ns() - start;
+    start = puf_be_now_ns();
+    for (i = 0; i < iterations; i++) {
+        sink = retention_exact_ms(60000, i % BENCH_DTEMP_CODES, 128, 10);
+    }
+    pow_ns = puf_be_now_ns() - start;
+    (void) sink;
+    printf("%12s %12s\n", "fixed ns", "pow ns");
+    printf("%12.1f %12.1f\n", (double) fixed_ns / iterations, (double) pow_ns / iterations);
+    return 0;
+}
+
+// Decays the simulated region for one warm up cycle. A cell decays if its retention,
+// in warm up periods, is below 1. While the device warms up the retention of each
+// cell deviates randomly by up to noise, halving with every cycle.
+static void warm_up_decay(uint8_t *region, const double *retention, double noise, uint32_t cycle) {
+    double   deviation = ldexp(noise, -(int) cycle);
+    uint32_t i;
+
+    memset(region, 0, BENCH_WARM_UP_BLOCKS * sizeof(uint16_t));
+    for (i = 0; i < BENCH_WARM_UP_BLOCKS * 16; i++) {
+        if (retention[i] * (1.0 + deviation * (2.0 * rand() / RAND_MAX - 1.0)) < 1.0) {
+            // the region is big endian, bit mask of the 16bit block.
+            region[(i / 16) * sizeof(uint16_t) + (i % 16 < 8 ? 1 : 0)] |= 1 << (i % 8);
+        }
+    }
+}
+
+// Runs warm_up_cycle against the simulated decay. The sampled cells are within a
+// factor 2 of the period but at least 25% off it, stable once the device is warm
+// but the first to flip while it warms up. Without cells every warm up has to run all cycles,
+// on a warm device it has to end after PUF_WARM_UP_STABLE cycles. Reports how
+// often it ended with the cells not yet at their values on the warm device.
+static int bench_warm_up(void) {
+    static const struct {
+        bool   sampled;
+        double noise;
+    } scenarios[] = { { false, 1.0 }, { true, 0.0 }, { true, 0.25 }, { true, 0.5 }, { true, 1.0 } };
+    double   retention[BENCH_WARM_UP_BLOCKS * 16];
+    uint8_t  region[BENCH_WARM_UP_BLOCKS * sizeof(uint16_t)];
+    uint32_t cells[PUF_WARM_UP_MAX_CELLS];
+    uint32_t warm, total, longest, unsettled, s, t, i;
+    int      count = 0, sampled;
+    struct warm_up_state state;
+
+    // retention log-uniform between 1/8 and 8 periods.
+    for (i = 0; i < BENCH_WARM_UP_BLOCKS * 16; i++) {
+        retention[i] = exp2(6.0 * rand() / RAND_MAX - 3.0);
+        if (count < PUF_WARM_UP_MAX_CELLS && retention[i] > 0.5 && retention[i] < 2.0
+            && fabs(retention[i] - 1.0) > 0.25) {
+            cells[count++] = i;
+        }
+    }
+    warm_up_decay(region, retention, 0.0, 0);
+    warm = warm_up_read_sample(region, cells, count);
+
+    printf("warm up, %u trials of at most %u cycles\n", BENCH_WARM_UP_TRIALS, BENCH_WARM_UP_CYCLES);
+    printf("%8s %8s %12s %12s %12s\n", "cells", "noise", "avg cycles", "max cycles", "unsettled %");
+
+    for (s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        sampled = scenarios[s].sampled ? count : 0;
+        total = longest = unsettled = 0;
+
+        for (t = 0; t < BENCH_WARM_UP_TRIALS; t++) {
+            state = (struct warm_up_state) {0};
+            do {
+                warm_up_decay(region, retention, scenarios[s].noise, state.cycles);
+            } while (!warm_up_cycle(&state, region, cells, sampled, BENCH_WARM_UP_CYCLES));
+
+            if (state.cycles > BENCH_WARM_UP_CYCLES || (sampled == 0 && state.cycles != BENCH_WARM_UP_CYCLES)
+                || (sampled > 0 && scenarios[s].noise == 0.0 && state.cycles != PUF_WARM_UP_STABLE)) {
+                fprintf(stderr, "warm up with %d cells and noise %.2f ended after %u cycles\n", sampled,
+                        scenarios[s].noise, state.cycles);
+                return -1;
+            }
+            total += state.cycles;
+            longest = state.cycles > longest ? state.cycles : longest;
+            unsettled += sampled > 0 && state.sample != warm;
+        }
+
+        printf("%8d %8.2f %12.2f %12u %12.1f\n", sampled, scenarios[s].noise, (double) total / BENCH_WARM_UP_TRIALS,
+               longest, 100.0 * unsettled / BENCH_WARM_UP_TRIALS);
+    }
+    return 0;
+}
+
+// Fills the record with random cells of the blocks [first, first + blocks), ordered
+// by their block like puf_decode_record does.
+static void slot_cells(struct puf_record *record, uint32_t first, uint32_t blocks) {
+    uint32_t i;
+
+    for (i = 0; i < 32; i++) {
+        record->cells[i].block = first + rand() % blocks;
+        record->cells[i].mask = rand() % 16;
+        record->cells[i].bit = i;
+    }
+    puf_be_sort(record->cells, 32, sizeof(struct puf_cell), puf_compare_cells);
+}
+
+// Slot of the enrollment, the same way as find_slot of the module.
+static int slot_of(const struct puf_record *records, uint32_t size, uint32_t count) {
+    uint32_t beg = UINT32_MAX;
+    uint32_t end = 0x0;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_SLOT_WINDOWS; i++) {
+        puf_record_span(&records[i], &beg, &end);
+    }
+    return puf_find_slot(beg, end, size, count);
+}
+
+// Clears the slot of the region the way the module does when the slot starts to
+// decay, and checks that only its bytes were cleared, those of its neighbours kept
+// the pattern the region was filled with.
+static int slot_isolated(uint8_t *region, uint32_t count, uint32_t index) {
+    uint32_t offset, size, i;
+
+    memset(region, BENCH_SLOT_PATTERN, BENCH_PUF_SIZE);
+    puf_slot_range(BENCH_PUF_SIZE, count, index, &offset, &size);
+    puf_clear_slot(region, offset, size);
+
+    for (i = 0; i < BENCH_PUF_SIZE; i++) {
+        if (region[i] != (i >= offset && i < offset + size ? 0x0 : BENCH_SLOT_PATTERN)) {
+            fprintf(stderr, "%u slots: starting slot %u changed byte %u of slot %u\n", count, index, i, i / size);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Splits the PUF region into slots and checks that an enrollment with its cells
+// within a slot, down to its first and last block, is bound to that slot, while one
+// with a single cell in the neighbouring slot or past the region is rejected. Starting
+// the bound slot has to leave the bytes of the other slots unchanged.
+static int bench_slots(void) {
+    static const uint32_t counts[] = { 1, 2, 4, 16 };
+    struct puf_record records[BENCH_SLOT_WINDOWS];
+    uint32_t size, blocks, c, s, i, bound, rejected;
+    int      slot;
+    uint8_t *region;
+
+    region = malloc(BENCH_PUF_SIZE);
+    if (!region) {
+        fprintf(stderr, "failed to allocate the PUF region\n");
+        return -1;
+    }
+
+    printf("slots, %u windows per enrollment\n", BENCH_SLOT_WINDOWS);
+    printf("%8s %12s %12s\n", "slots", "bound", "rejected");
+
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        size = BENCH_PUF_SIZE / counts[c];
+        blocks = size / sizeof(uint16_t);
+        bound = rejected = 0;
+
+        for (s = 0; s < counts[c]; s++) {
+            for (i = 0; i < BENCH_SLOT_WINDOWS; i++) {
+                slot_cells(&records[i], s * blocks, blocks);
+            }
+            // the edges of the slot, the cells stay ordered.
+            records[0].cells[0].block = s * blocks;
+            records[BENCH_SLOT_WINDOWS - 1].cells[31].block = (s + 1) * blocks - 1;
+
+            slot = slot_of(records, size, counts[c]);
+            if (slot != (int) s) {
+                fprintf(stderr, "%u slots: enrollment of slot %u bound to %d\n", counts[c], s, slot);
+                free(region);
+                return -1;
+            }
+            if (slot_isolated(region, counts[c], slot) < 0) {
+                free(region);
+                return -1;
+            }
+            bound++;
+
+            // a single cell in the next slot (or past the region for the last one).
+            records[BENCH_SLOT_WINDOWS / 2].cells[31].block = (s + 1) * blocks;
+            slot = slot_of(records, size, counts[c]);
+            if (slot >= 0) {
+                fprintf(stderr, "%u slots: enrollment spanning slot %u and the next bound to %d\n", counts[c], s,
+                        slot);
+                free(region);
+                return -1;
+            }
+            rejected++;
+
+            // a single cell in the previous slot.
+            if (s > 0) {
+                slot_cells(&records[BENCH_SLOT_WINDOWS / 2], s * blocks, blocks);
+                records[BENCH_SLOT_WINDOWS / 2].cells[0].block = s * blocks - 1;
+                slot = slot_of(records, size, counts[c]);
+                if (slot >= 0) {
+                    fprintf(stderr, "%u slots: enrollment spanning slot %u and the previous bound to %d\n",
+                            counts[c], s, slot);
+                    free(region);
+                    return -1;
+                }
+                rejected++;
+            }
+        }
+
+        printf("%8u %12u %12u\n", counts[c], bound, rejected);
+    }
+
+    free(region);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+    uint32_t region_mb  = argc > 2 ? strtoul(argv[2], NULL, 0) : 512;
+    uint8_t *region;
+    uint32_t i;
+    int      err;
+
+    if (iterations == 0 || region_mb == 0 || region_mb > 2048) {
+        fprintf(stderr, "usage: %s [iterations] [refresh-region-mb]\n", argv[0]);
+        return 1;
+    }
+
+    // the decayed cells, random values.
+    srand(1);
+    region = malloc(BENCH_PUF_SIZE);
+    if (!region) {
+        return 1;
+    }
+    for (i = 0; i < BENCH_PUF_SIZE; i++) {
+        region[i] = rand();
+    }
+
+    err = bench_codec(iterations);
+    if (!err) {
+        err = bench_read_path(region, iterations);
+    }
+    free(region);
+    if (!err) {
+        err = bench_retention(iterations);
+    }
+    if (!err) {
+        err = bench_warm_up();
+    }
+    if (!err) {
+        err = bench_slots();
+    }
+    if (!err) {
+        err = bench_refresh(region_mb);
+    }
+    return err ? 1 : 0;
+}
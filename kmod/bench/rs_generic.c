@@ -0,0 +1,13 @@
+// The Reed Solomon codec without the split nibble tables (CONFIG_REED_SOLOMON_SPLIT8),
+// the baseline puf_bench compares the table driven kernels with. Built as a unit of
+// its own, its entry points are prefixed with generic_.
+
+#define init_rs_gfp             generic_init_rs_gfp
+#define init_rs_non_canonical   generic_init_rs_non_canonical
+#define free_rs                 generic_free_rs
+#define encode_rs8              generic_encode_rs8
+#define decode_rs8              generic_decode_rs8
+
+#define CONFIG_REED_SOLOMON_ENC8
+#define CONFIG_REED_SOLOMON_DEC8
+#include "ecc/reed_solomon.c"
@@ -0,0 +1,25 @@
+#ifndef PUF_BACKEND_H
+#define PUF_BACKEND_H
+
+// Backend of the portable PUF core (puf_core.h, refresh.h, retention.h, warm_up.h).
+//
+// The core is written against this small interface only, implemented once for
+// the kernel (backend_linux.h) and once for userspace (backend_user.h), so that
+// it can be run and profiled off the BeagleBone (see kmod/bench). The backend is
+// picked at compile time, as the calls sit on the read and refresh paths.
+//
+// memory    - uint16_t puf_be_r16_be(const uint8_t *addr)   big endian 16bit block of the PUF mapping.
+//             puf_be_touch(ptr)                              load that activates (refreshes) the row of ptr.
+// registers - puf_be_reg_map(phys, size), puf_be_reg_unmap(regs)
+//             puf_be_reg_read(ptr), puf_be_reg_write(val, ptr) 32bit register access within a mapping.
+// timers    - uint64_t puf_be_now_ns(void)                   monotonic time.
+// logging   - puf_be_log(fmt, ...), puf_be_err(fmt, ...)
+// sorting   - puf_be_sort(base, num, size, cmp)
+
+#ifdef __KERNEL__
+#include "backend_linux.h"
+#else
+#include "backend_user.h"
+#endif
+
+#endif // PUF_BACKEND_H
@@ -0,0 +1,34 @@
+#ifndef PUF_BACKEND_LINUX_H
+#define PUF_BACKEND_LINUX_H
+
+// Kernel backend of the PUF core, see backend.h.
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+
+static inline uint16_t puf_be_r16_be(const uint8_t *addr) {
+    return (((uint16_t) addr[0]) << 8) | addr[1];
+}
+
+#define puf_be_reg_map(phys, size)  ioremap(phys, size)
+#define puf_be_reg_unmap(regs)      iounmap(regs)
+#define puf_be_reg_read(ptr)        readl(ptr)
+#define puf_be_reg_write(val, ptr)  writel(val, ptr)
+
+#define puf_be_touch(ptr) ((void) READ_ONCE(*(volatile uint32_t *) (ptr)))
+
+static inline uint64_t puf_be_now_ns(void) {
+    return ktime_get_ns();
+}
+
+#define puf_be_log(fmt, ...) printk(KERN_INFO fmt, ##__VA_ARGS__)
+#define puf_be_err(fmt, ...) printk(KERN_ERR fmt, ##__VA_ARGS__)
+
+#define puf_be_sort(base, num, size, cmp) sort(base, num, size, cmp, NULL)
+
+#endif // PUF_BACKEND_LINUX_H
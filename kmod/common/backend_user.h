@@ -0,0 +1,97 @@
+#ifndef PUF_BACKEND_USER_H
+#define PUF_BACKEND_USER_H
+
+// Userspace backend of the PUF core, see backend.h. The PUF region is an
+// ordinary buffer, e.g. filled from a dump of the decayed cells.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static inline uint16_t puf_be_r16_be(const uint8_t *addr) {
+    return (((uint16_t) addr[0]) << 8) | addr[1];
+}
+
+#ifndef BIT
+#define BIT(n) (1UL << (n))
+#endif
+
+#define __iomem
+
+// registers are backed by zeroed memory, inspect or preset them through the mapping.
+static inline void *puf_be_reg_map(uint32_t phys, size_t size) {
+    (void) phys;
+    return calloc(1, size);
+}
+
+#define puf_be_reg_unmap(regs)      free(regs)
+#define puf_be_reg_read(ptr)        (*(volatile uint32_t *) (ptr))
+#define puf_be_reg_write(val, ptr)  (*(volatile uint32_t *) (ptr) = (val))
+
+#define puf_be_touch(ptr) ((void) *(volatile uint32_t *) (ptr))
+
+static inline uint64_t puf_be_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define puf_be_log(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#define puf_be_err(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#define puf_be_sort(base, num, size, cmp) qsort(base, num, size, cmp)
+
+// Kernel primitives the Reed Solomon codec (puf/ecc) is written against.
+typedef unsigned int gfp_t;
+#define GFP_KERNEL 0
+
+static inline void *kzalloc(size_t size, gfp_t gfp) {
+    (void) gfp;
+    return calloc(1, size);
+}
+
+static inline void *kmalloc_array(size_t n, size_t size, gfp_t gfp) {
+    (void) gfp;
+    return malloc(n * size);
+}
+
+static inline void kfree(const void *ptr) {
+    free((void *) ptr);
+}
+
+struct list_head {
+    struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(name) struct list_head name = { &(name), &(name) }
+#define INIT_LIST_HEAD(head) do { (head)->next = (head); (head)->prev = (head); } while (0)
+#define list_entry(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+#define list_for_each(pos, head) for (pos = (head)->next; pos != (head); pos = pos->next)
+
+static inline void list_add(struct list_head *entry, struct list_head *head) {
+    entry->next = head->next;
+    entry->prev = head;
+    head->next->prev = entry;
+    head->next = entry;
+}
+
+static inline void list_del(struct list_head *entry) {
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+}
+
+#define DEFINE_MUTEX(name) pthread_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+#define mutex_lock(m) pthread_mutex_lock(m)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define BUG_ON(cond) do { if (cond) abort(); } while (0)
+#define EXPORT_SYMBOL_GPL(sym)
+
+#endif // PUF_BACKEND_USER_H
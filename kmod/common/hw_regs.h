@@ -0,0 +1,90 @@
+#ifndef PUF_HW_REGS_H
+#define PUF_HW_REGS_H
+
+// Register windows of the AM335x (BeagleBone Black) used by the PUF modules.
+// Both windows are mapped once when the module is loaded, the accessors below
+// only translate the physical register address into the mapping.
+//
+// The windows are mapped through the backend (backend.h), outside of the kernel
+// they are backed by plain memory, so that code using the registers can be
+// exercised in userspace.
+
+#define CNTRL_MOD_REG               0x44E10000                // Control Module registers offset.
+#define CNTRL_MOD_SIZE              0x1000                    // Mapped part of the Control Module.
+#define BANDGAP_CTRL                CNTRL_MOD_REG + 0x0448    // Bandgap control register for reading temperature.
+#define BANDGAP_CTRL_DTEMP_OFF      8                         // Offset for temperature reading.
+#define BANDGAP_CTRL_DTEMP_MASK     0x0000FF00                // Bits used for temperature.
+#define BANDGAP_CTRL_TMPOFF         BIT(5)
+#define BANDGAP_CTRL_SOC            BIT(4)
+#define BANDGAP_CTRL_CLRZ           BIT(3)
+#define BANDGAP_CTRL_CONTCONV       BIT(2)
+
+#define EMIF0_REG                   0x4C000000                // EMIF0 register base.
+#define EMIF0_SIZE                  0x1000                    // Mapped part of the EMIF0 registers.
+#define SDRAM_REF_CTRL              EMIF0_REG + 0x10          // Offset for the register of the SDRAM REFRESH CONTROL register.
+#define SDRAM_REF_CTRL_SDHW         EMIF0_REG + 0x14          // Offset for shadow register of the SDRAM REFRESH CONTROL register.
+
+#define DISABLE_REFRESH             BIT(31)                   // Bit to flip to disable/enable SDRAM refresh.
+
+#include "backend.h"
+
+static void __iomem *hw_regs_cntrl = NULL;
+static void __iomem *hw_regs_emif0 = NULL;
+
+static inline void hw_regs_unmap(void) {
+    if (hw_regs_cntrl) {
+        puf_be_reg_unmap(hw_regs_cntrl);
+        hw_regs_cntrl = NULL;
+    }
+    if (hw_regs_emif0) {
+        puf_be_reg_unmap(hw_regs_emif0);
+        hw_regs_emif0 = NULL;
+    }
+}
+
+static inline int hw_regs_map(void) {
+    hw_regs_cntrl = puf_be_reg_map(CNTRL_MOD_REG, CNTRL_MOD_SIZE);
+    hw_regs_emif0 = puf_be_reg_map(EMIF0_REG, EMIF0_SIZE);
+    if (!hw_regs_cntrl || !hw_regs_emif0) {
+        hw_regs_unmap();
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+#define hw_regs_read(ptr)         puf_be_reg_read(ptr)
+#define hw_regs_write(val, ptr)   puf_be_reg_write(val, ptr)
+
+// Returns the mapping of the register at the physical address, NULL if
+// the address is outside of the mapped windows.
+static inline void __iomem *hw_reg_addr(uint32_t addr) {
+    if (hw_regs_cntrl && addr >= CNTRL_MOD_REG && addr - CNTRL_MOD_REG < CNTRL_MOD_SIZE) {
+        return (char __iomem *) hw_regs_cntrl + (addr - CNTRL_MOD_REG);
+    }
+    if (hw_regs_emif0 && addr >= EMIF0_REG && addr - EMIF0_REG < EMIF0_SIZE) {
+        return (char __iomem *) hw_regs_emif0 + (addr - EMIF0_REG);
+    }
+    return NULL;
+}
+
+static inline int hw_reg_r32(uint32_t addr, uint32_t *out) {
+    void __iomem *reg = hw_reg_addr(addr);
+    if (!reg) {
+        return -1;
+    }
+
+    *out = hw_regs_read(reg);
+    return 0;
+}
+
+static inline int hw_reg_w32(uint32_t addr, uint32_t val) {
+    void __iomem *reg = hw_reg_addr(addr);
+    if (!reg) {
+        return -1;
+    }
+
+    hw_regs_write(val, reg);
+    return 0;
+}
+
+#endif // PUF_HW_REGS_H
@@ -0,0 +1,341 @@
+#ifndef PUF_REFRESH_H
+#define PUF_REFRESH_H
+
+// Software refresh of the SDRAM, used while the hardware refresh is disabled.
+//
+// Each row of the refreshed region is touched once per pass, except for the rows
+// overlapping one of the excluded ranges (the decaying PUF cells). A pass is split
+// into chunks run one after another within the refresh period, each chunk covering
+// groups of consecutive rows that fall into different banks, so that consecutive
+// row activations can overlap.
+//
+// The engine measures itself: the interval between the starts of two passes is
+// the time each row goes without refresh and is checked against the retention
+// deadline of the SDRAM, the busy time is the time spent touching the rows.
+//
+// Memory access and timing go through the backend (backend.h), so that outside of
+// the kernel the engine refreshes an ordinary buffer and can be measured in userspace.
+
+#define REFRESH_DEADLINE_MS     64                            // Retention time guaranteed by the DDR3 specification.
+#define REFRESH_BANKS           8                             // Number of banks of the DDR3 chip.
+
+#include "backend.h"
+
+#ifdef __KERNEL__
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/workqueue.h>
+#endif
+
+#define refresh_now_ns()        puf_be_now_ns()
+#define refresh_touch(ptr)      puf_be_touch(ptr)
+
+// Physical address range [beg, end) excluded from the refresh.
+struct refresh_range {
+    uint32_t beg;
+    uint32_t end;
+};
+
+struct refresh_engine {
+    // configuration, set before the first pass.
+    uint32_t                    base;           // physical start of the refreshed region.
+    uint32_t                    end;            // physical end (exclusive) of the refreshed region.
+    uint8_t*                    virt_base;      // mapping of base.
+    uint32_t                    row_size;       // bytes per row, one load per row refreshes it.
+    uint32_t                    banks;          // rows of consecutive banks touched back to back.
+    uint32_t                    chunks;         // number of chunks a pass is split into.
+    uint32_t                    deadline_ms;    // a row has to be touched at least this often.
+    const struct refresh_range* excluded;       // sorted, non-overlapping excluded ranges.
+    uint32_t                    excluded_count;
+
+    // state of the current pass.
+    uint32_t                    next_chunk;
+    uint64_t                    pass_start_ns;
+    uint64_t                    pass_busy_ns;
+    uint32_t                    pass_rows;
+
+    // statistics, of the last completed pass and overall.
+    uint64_t                    passes;
+    uint64_t                    overruns;       // passes that started later than the deadline after the previous one.
+    uint64_t                    last_interval_ns;
+    uint64_t                    max_interval_ns;
+    uint64_t                    last_busy_ns;
+    uint64_t                    max_busy_ns;
+    uint32_t                    last_rows;
+};
+
+// Sorts the excluded ranges by their start, the engine expects them sorted.
+static inline void refresh_sort_excluded(struct refresh_range *ranges, uint32_t count) {
+    uint32_t i, j;
+    struct refresh_range tmp;
+
+    for (i = 1; i < count; i++) {
+        tmp = ranges[i];
+        for (j = i; j > 0 && ranges[j - 1].beg > tmp.beg; j--) {
+            ranges[j] = ranges[j - 1];
+        }
+        ranges[j] = tmp;
+    }
+}
+
+static inline void refresh_init(struct refresh_engine *e, uint32_t base, uint32_t end, uint8_t *virt_base,
+                                uint32_t row_size, const struct refresh_range *excluded, uint32_t excluded_count) {
+    *e = (struct refresh_engine) {
+        .base           = base,
+        .end            = end,
+        .virt_base      = virt_base,
+        .row_size       = row_size,
+        .banks          = REFRESH_BANKS,
+        .chunks         = 1,
+        .deadline_ms    = REFRESH_DEADLINE_MS,
+        .excluded       = excluded,
+        .excluded_count = excluded_count,
+    };
+}
+
+// Refreshes the next chunk of the pass. Returns true if it completed the pass.
+static inline bool refresh_chunk(struct refresh_engine *e) {
+    uint64_t start, interval;
+    uint32_t rows, group, groups, bank, row;
+    uint32_t addr;
+    uint32_t next_excluded = 0;
+
+    start = refresh_now_ns();
+    if (e->next_chunk == 0) {
+        if (e->pass_start_ns != 0) {
+            interval = start - e->pass_start_ns;
+            e->last_interval_ns = interval;
+            if (interval > e->max_interval_ns) {
+                e->max_interval_ns = interval;
+            }
+            if (interval > (uint64_t) e->deadline_ms * 1000000ull) {
+                e->overruns++;
+            }
+        }
+        e->pass_start_ns = start;
+        e->pass_busy_ns = 0;
+        e->pass_rows = 0;
+    }
+
+    rows = (e->end - e->base) / e->row_size;
+    groups = (rows + e->banks - 1) / e->banks;
+
+    // the chunk covers every chunks-th group of banks rows, in ascending
+    // order, so the excluded ranges are walked once.
+    for (group = e->next_chunk; group < groups; group += e->chunks) {
+        for (bank = 0; bank < e->banks; bank++) {
+            row = group * e->banks + bank;
+            if (row >= rows) {
+                break;
+            }
+            addr = e->base + row * e->row_size;
+
+            while (next_excluded < e->excluded_count && e->excluded[next_excluded].end <= addr) {
+                next_excluded++;
+            }
+            // skip the row if any of its bytes is excluded, touching
+            // it would refresh the excluded cells as well.
+            if (next_excluded < e->excluded_count
+                && e->excluded[next_excluded].beg < addr + e->row_size) {
+                continue;
+            }
+
+            refresh_touch(e->virt_base + (addr - e->base));
+            e->pass_rows++;
+        }
+    }
+
+    e->pass_busy_ns += refresh_now_ns() - start;
+    e->next_chunk++;
+    if (e->next_chunk < e->chunks) {
+        return false;
+    }
+
+    e->next_chunk = 0;
+    e->passes++;
+    e->last_busy_ns = e->pass_busy_ns;
+    if (e->pass_busy_ns > e->max_busy_ns) {
+        e->max_busy_ns = e->pass_busy_ns;
+    }
+    e->last_rows = e->pass_rows;
+    return true;
+}
+
+// Runs a complete pass right away, regardless of the chunking.
+static inline void refresh_pass(struct refresh_engine *e) {
+    while (!refresh_chunk(e));
+}
+
+#ifdef __KERNEL__
+
+// Where the chunks of the refresh are run from.
+enum refresh_mode {
+    REFRESH_WORKQUEUE = 0, // delayed work, limited to the jiffy resolution.
+    REFRESH_HRTIMER   = 1, // soft hrtimer, the chunks run in softirq context.
+    REFRESH_KTHREAD   = 2, // kthread bound to a single CPU, sleeping on hrtimers.
+};
+
+struct refresh_runner {
+    struct refresh_engine* engine;
+    enum refresh_mode      mode;
+    int                    cpu;          // CPU of the kthread.
+    uint32_t               period_ms;    // a pass is started every period.
+    void                   (*on_pass)(struct refresh_engine *);
+
+    bool                   running;
+    struct delayed_work    work;
+    struct hrtimer         timer;
+    struct task_struct*    thread;
+};
+
+static inline uint64_t refresh_tick_ns(struct refresh_runner *r) {
+    return (uint64_t) r->period_ms * NSEC_PER_MSEC / r->engine->chunks;
+}
+
+static inline void refresh_run_chunk(struct refresh_runner *r) {
+    if (refresh_chunk(r->engine) && r->on_pass) {
+        r->on_pass(r->engine);
+    }
+}
+
+static void refresh_work(struct work_struct *work) {
+    struct refresh_runner *r = container_of(to_delayed_work(work), struct refresh_runner, work);
+
+    schedule_delayed_work(&r->work, nsecs_to_jiffies(refresh_tick_ns(r)));
+    refresh_run_chunk(r);
+}
+
+static enum hrtimer_restart refresh_timer(struct hrtimer *timer) {
+    struct refresh_runner *r = container_of(timer, struct refresh_runner, timer);
+
+    hrtimer_forward_now(timer, ns_to_ktime(refresh_tick_ns(r)));
+    refresh_run_chunk(r);
+
+    return HRTIMER_RESTART;
+}
+
+static int refresh_thread(void *data) {
+    struct refresh_runner *r = data;
+    ktime_t next = ktime_get();
+
+    while (!kthread_should_stop()) {
+        refresh_run_chunk(r);
+
+        next = ktime_add_ns(next, refresh_tick_ns(r));
+        set_current_state(TASK_INTERRUPTIBLE);
+        schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+    }
+
+    return 0;
+}
+
+static inline void refresh_runner_init(struct refresh_runner *r, struct refresh_engine *e,
+                                       enum refresh_mode mode, int cpu, uint32_t period_ms) {
+    r->engine = e;
+    r->mode = mode;
+    r->cpu = cpu;
+    r->period_ms = period_ms;
+    r->on_pass = NULL;
+    r->running = false;
+    r->thread = NULL;
+
+    INIT_DELAYED_WORK(&r->work, refresh_work);
+    hrtimer_init(&r->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+    r->timer.function = refresh_timer;
+}
+
+static inline int refresh_start(struct refresh_runner *r) {
+    if (r->running) {
+        return 0;
+    }
+
+    // a new session, the time the refresh was stopped is not an overrun.
+    r->engine->next_chunk = 0;
+    r->engine->pass_start_ns = 0;
+
+    switch (r->mode) {
+    case REFRESH_HRTIMER:
+        hrtimer_start(&r->timer, ns_to_ktime(refresh_tick_ns(r)), HRTIMER_MODE_REL_SOFT);
+        break;
+    case REFRESH_KTHREAD:
+        r->thread = kthread_create(refresh_thread, r, "puf_refresh/%d", r->cpu);
+        if (IS_ERR(r->thread)) {
+            int err = PTR_ERR(r->thread);
+            r->thread = NULL;
+            return err;
+        }
+        kthread_bind(r->thread, r->cpu);
+        wake_up_process(r->thread);
+        break;
+    case REFRESH_WORKQUEUE:
+    default:
+        schedule_delayed_work(&r->work, nsecs_to_jiffies(refresh_tick_ns(r)));
+        break;
+    }
+
+    r->running = true;
+    return 0;
+}
+
+static inline void refresh_stop(struct refresh_runner *r) {
+    struct refresh_engine *e = r->engine;
+
+    if (!r->running) {
+        return;
+    }
+
+    switch (r->mode) {
+    case REFRESH_HRTIMER:
+        hrtimer_cancel(&r->timer);
+        break;
+    case REFRESH_KTHREAD:
+        kthread_stop(r->thread);
+        r->thread = NULL;
+        break;
+    case REFRESH_WORKQUEUE:
+    default:
+        cancel_delayed_work_sync(&r->work);
+        break;
+    }
+
+    r->running = false;
+    printk(KERN_INFO "refresh: %llu passes, %llu overruns, max interval %llu us, max busy %llu us\n",
+           e->passes, e->overruns, e->max_interval_ns / 1000, e->max_busy_ns / 1000);
+}
+
+// Configuration of the software refresh, parameters of each module including this header.
+static uint32_t refresh_mode = REFRESH_WORKQUEUE;
+module_param(refresh_mode, uint, 0);
+MODULE_PARM_DESC(refresh_mode, "run the software refresh from 0 - a workqueue (default), 1 - a hrtimer, 2 - a kthread pinned to refresh_cpu");
+
+static uint32_t refresh_chunks = 1;
+module_param(refresh_chunks, uint, 0);
+MODULE_PARM_DESC(refresh_chunks, "number of chunks each software refresh pass is split into (default 1)");
+
+static int refresh_cpu = 0;
+module_param(refresh_cpu, int, 0);
+MODULE_PARM_DESC(refresh_cpu, "CPU the refresh kthread is pinned to");
+
+// Sets up the engine refreshing [base, end) of the SDRAM mapped at virt_base outside
+// of the excluded ranges, and its runner starting a pass every period_ms, as configured
+// by the module parameters. The ranges are sorted in place.
+static inline int refresh_setup(struct refresh_runner *r, struct refresh_engine *e, uint32_t base, uint32_t end,
+                                uint8_t *virt_base, uint32_t row_size, struct refresh_range *excluded,
+                                uint32_t excluded_count, uint32_t period_ms) {
+    if (refresh_chunks == 0 || refresh_mode > REFRESH_KTHREAD) {
+        printk(KERN_ERR "invalid software refresh configuration\n");
+        return -EINVAL;
+    }
+
+    refresh_sort_excluded(excluded, excluded_count);
+    refresh_init(e, base, end, virt_base, row_size, excluded, excluded_count);
+    e->chunks = refresh_chunks;
+
+    refresh_runner_init(r, e, refresh_mode, refresh_cpu, period_ms);
+    return 0;
+}
+
+#endif // __KERNEL__
+
+#endif // PUF_REFRESH_H
@@ -0,0 +1,64 @@
+#ifndef PUF_RETENTION_H
+#define PUF_RETENTION_H
+
+// Retention of the DRAM cells vs temperature.
+//
+// The retention time of the cells halves for every `halving` steps the temperature
+// rises, so a decay window enrolled for decay_ms at the reference temperature reaches
+// the same decay state after
+//
+//      decay_ms * 2^((reference - temperature) / halving)
+//
+// i.e. shorter on a hotter device and longer on a colder one. The temperatures are
+// DTEMP codes of the bandgap sensor, the same unit the puf and plain_puf modules log,
+// so the reference can be taken from the enrollment measurements without converting.
+//
+// Built outside of the kernel (without __KERNEL__) the model can be run in userspace.
+
+#define RETENTION_MAX_HALVINGS  4                             // The compensation is clamped to 1/16x .. 16x.
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+// 2^(x / 65536) * 65536 for x within [0, 65536), by a second order polynomial
+// (max error below 0.5%), exact at both ends.
+static inline uint32_t retention_exp2_frac(uint32_t x) {
+    return 65536 + ((x * (43024 + ((22512 * x) >> 16))) >> 16);
+}
+
+// Decay time equivalent to decay_ms at the reference temperature, or decay_ms
+// if halving is 0 (no compensation).
+static inline uint32_t retention_scale_ms(uint32_t decay_ms, int32_t temperature, int32_t reference,
+                                          uint32_t halving) {
+    int32_t  exponent;
+    int32_t  halvings;
+    uint64_t scaled;
+
+    if (halving == 0) {
+        return decay_ms;
+    }
+
+    // exponent in 16.16 fixed point, clamped.
+    exponent = (reference - temperature) * 65536 / (int32_t) halving;
+    if (exponent > RETENTION_MAX_HALVINGS * 65536) {
+        exponent = RETENTION_MAX_HALVINGS * 65536;
+    } else if (exponent < -RETENTION_MAX_HALVINGS * 65536) {
+        exponent = -RETENTION_MAX_HALVINGS * 65536;
+    }
+
+    // floor of the exponent and its (non-negative) fraction.
+    halvings = exponent >= 0 ? exponent / 65536 : -((-exponent + 65535) / 65536);
+    scaled = (uint64_t) decay_ms * retention_exp2_frac((uint32_t) (exponent - halvings * 65536));
+    scaled = halvings >= 0 ? scaled << halvings : scaled >> -halvings;
+    scaled >>= 16;
+
+    if (scaled == 0) {
+        return 1;
+    }
+    return scaled > 0xffffffffu ? 0xffffffffu : (uint32_t) scaled;
+}
+
+#endif // PUF_RETENTION_H
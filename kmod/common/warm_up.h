@@ -0,0 +1,63 @@
+#ifndef PUF_WARM_UP_H
+#define PUF_WARM_UP_H
+
+// End of the warm up after the module is loaded.
+//
+// The PUF region is decayed in cycles until the cells behave consistently. With
+// stable cells known (pointers in the format of the enrollment) the cells are
+// sampled at the end of every cycle and the warm up ends once PUF_WARM_UP_STABLE
+// consecutive samples read the same, at the latest after max_cycles. Without them
+// all max_cycles cycles are run.
+//
+// The cells are read through the backend (backend.h), so that outside of the kernel
+// the decision can be run against a simulated decay (see kmod/bench).
+
+#define PUF_WARM_UP_MAX_CELLS   32                            // Upper bound of the sampled cells.
+#define PUF_WARM_UP_STABLE      2                             // Matching consecutive samples ending the warm up.
+
+#include "backend.h"
+
+struct warm_up_state {
+    uint32_t cycles;    // completed cycles.
+    uint32_t stable;    // consecutive cycles the sample did not change.
+    uint32_t sample;    // bit i holds the value of cells[i].
+};
+
+// Reads the cells from the PUF mapped at base, bit i of the sample holds the value of cells[i].
+static inline uint32_t warm_up_read_sample(const uint8_t *base, const uint32_t *cells, int count) {
+    int      i;
+    uint16_t memory;
+    uint32_t sample = 0x0;
+
+    for (i = 0; i < count; i++) {
+        memory = puf_be_r16_be(base + (cells[i] >> 4) * sizeof(uint16_t));
+        if (memory & (1 << (cells[i] & 0xf))) {
+            sample |= 1 << i;
+        }
+    }
+
+    return sample;
+}
+
+// Accounts a completed cycle, sampling the count cells of the PUF mapped at base.
+// Returns true once the warm up is complete.
+static inline bool warm_up_cycle(struct warm_up_state *state, const uint8_t *base, const uint32_t *cells, int count,
+                                 uint32_t max_cycles) {
+    uint32_t sample;
+
+    state->cycles += 1;
+
+    if (count > 0) {
+        sample = warm_up_read_sample(base, cells, count);
+        if (state->cycles > 1 && sample == state->sample) {
+            state->stable += 1;
+        } else {
+            state->stable = 1;
+        }
+        state->sample = sample;
+    }
+
+    return state->stable >= PUF_WARM_UP_STABLE || state->cycles >= max_cycles;
+}
+
+#endif // PUF_WARM_UP_H
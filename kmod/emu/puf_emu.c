@@ -0,0 +1,689 @@
+// Userspace emulator of /dev/puf, loaded with LD_PRELOAD into a protected binary.
+//
+// Opening the device (PUF_EMU_DEVICE, /dev/puf by default) returns a session backed
+// by a memfd instead, its read(), write(), mmap(), ioctl() and close() follow the
+// puf module (kmod/puf/device.c). The windows of the enrollment are decoded with the
+// portable core of the module (puf_core.h) and their cells are read from the enrollment
+// measurements, the dumps the enroll tool generated the enrollment from. Every other
+// file descriptor is passed through.
+//
+// PUF_EMU_DUMPS       directory of the measurements (enrollments/enroll_BBB), required.
+// PUF_EMU_PREFIX      common prefix of the measurements, BBB by default.
+// PUF_EMU_ITERATION   iteration (replication) whose measurements are read, 1 by default.
+// PUF_EMU_TIME_SCALE  factor the decay times are scaled by, 1 by default (0.01 decays 100x faster).
+// PUF_EMU_BER         probability of flipping each response bit before the correction, 0 by default.
+// PUF_EMU_SEED        seed of the bit errors, 1 by default.
+// PUF_EMU_VERBOSE     log the enrollments and the corrections of each session if set.
+//
+// Not emulated: slots, the response cache, pre-decay (the ioctls succeed without effect),
+// poll() and the temperature compensation (the device runs at the enrollment temperature).
+
+#define _GNU_SOURCE
+
+#define CONFIG_REED_SOLOMON_DEC8
+#define CONFIG_REED_SOLOMON_SPLIT8
+#include "ecc/reed_solomon.c"
+
+#include "puf_core.h"
+#include "puf_ioctl.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define EMU_EXPORT              __attribute__((visibility("default")))
+
+#define EMU_MAX_SESSIONS        16                            // Upper bound of concurrently open devices.
+#define EMU_MAX_DUMPS           64                            // Upper bound of distinct decay times.
+
+// A decay window of the enrollment.
+struct emu_window {
+    struct puf_record enrolled;
+    uint64_t          deadline_ns;  // monotonic time the decay elapses at.
+    uint32_t          response;     // response read at the deadline, with the injected errors corrected.
+    bool              read;         // handed to the program, by read() or the page.
+};
+
+struct emu_session {
+    int                       fd;   // memfd backing the session, -1 if the entry is free.
+    int                       flags;
+    struct emu_window*        windows;
+    uint32_t                  windows_count;
+    uint32_t                  windows_read;
+    struct puf_response_page* page; // writable view of the memfd, once the program mapped it.
+    bool                      publishing;
+    bool                      closing;
+    uint32_t                  readers;  // threads blocked in read(), close waits for them.
+    pthread_t                 publisher;
+    pthread_cond_t            wake;
+
+    // statistics, logged on close with PUF_EMU_VERBOSE.
+    uint64_t                  flipped;
+    uint64_t                  corrected;
+    uint64_t                  failed;
+};
+
+// A measurement of the PUF region after decay_ms.
+struct emu_dump {
+    uint32_t decay_ms;
+    uint8_t* data;
+    size_t   size;
+};
+
+static int     (*real_open)(const char *, int, ...);
+static int     (*real_openat)(int, const char *, int, ...);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static int     (*real_close)(int);
+static void*   (*real_mmap)(void *, size_t, int, int, int, off_t);
+static int     (*real_ioctl)(int, unsigned long, ...);
+
+static pthread_once_t  emu_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t emu_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_condattr_t emu_condattr;
+
+static const char* emu_device = "/dev/puf";
+static const char* emu_dumps  = NULL;
+static const char* emu_prefix = "BBB";
+static uint32_t    emu_iteration  = 1;
+static double      emu_time_scale = 1.0;
+static double      emu_ber        = 0.0;
+static uint32_t    emu_seed       = 1;
+static bool        emu_verbose    = false;
+
+static struct emu_session emu_sessions[EMU_MAX_SESSIONS];
+static uint32_t           emu_sessions_open = 0;
+static struct emu_dump    emu_dumps_loaded[EMU_MAX_DUMPS];
+static uint32_t           emu_dumps_count = 0;
+static struct rs_control* emu_rs[PUF_MAX_PARITY + 1];
+
+#define emu_log(fmt, ...) do { if (emu_verbose) puf_be_log("puf-emu: " fmt, ##__VA_ARGS__); } while (0)
+
+static void emu_init(void) {
+    const char *env;
+    uint32_t    i;
+
+    real_open   = dlsym(RTLD_NEXT, "open");
+    real_openat = dlsym(RTLD_NEXT, "openat");
+    real_read   = dlsym(RTLD_NEXT, "read");
+    real_write  = dlsym(RTLD_NEXT, "write");
+    real_close  = dlsym(RTLD_NEXT, "close");
+    real_mmap   = dlsym(RTLD_NEXT, "mmap");
+    real_ioctl  = dlsym(RTLD_NEXT, "ioctl");
+
+    if ((env = getenv("PUF_EMU_DEVICE")) && *env) {
+        emu_device = env;
+    }
+    emu_dumps = getenv("PUF_EMU_DUMPS");
+    if ((env = getenv("PUF_EMU_PREFIX")) && *env) {
+        emu_prefix = env;
+    }
+    if ((env = getenv("PUF_EMU_ITERATION"))) {
+        emu_iteration = strtoul(env, NULL, 0);
+    }
+    if ((env = getenv("PUF_EMU_TIME_SCALE"))) {
+        emu_time_scale = strtod(env, NULL);
+    }
+    if ((env = getenv("PUF_EMU_BER"))) {
+        emu_ber = strtod(env, NULL);
+    }
+    if ((env = getenv("PUF_EMU_SEED"))) {
+        emu_seed = strtoul(env, NULL, 0);
+    }
+    emu_verbose = getenv("PUF_EMU_VERBOSE") != NULL;
+
+    pthread_condattr_init(&emu_condattr);
+    pthread_condattr_setclock(&emu_condattr, CLOCK_MONOTONIC);
+    for (i = 0; i < EMU_MAX_SESSIONS; i++) {
+        emu_sessions[i].fd = -1;
+    }
+}
+
+static inline void emu_resolve(void) {
+    pthread_once(&emu_once, emu_init);
+}
+
+// Session of fd, called with emu_lock held.
+static struct emu_session *emu_session(int fd) {
+    uint32_t i;
+
+    for (i = 0; i < EMU_MAX_SESSIONS; i++) {
+        if (emu_sessions[i].fd == fd) {
+            return &emu_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+// Whether fd may belong to a session, without taking the lock on the
+// paths of every other file descriptor of the program.
+static inline bool emu_maybe_session(int fd) {
+    return fd >= 0 && __atomic_load_n(&emu_sessions_open, __ATOMIC_ACQUIRE) != 0;
+}
+
+// Measurement of the region after decay_ms, <prefix>_<iteration>_<ms>ms or
+// <prefix>_<iteration>_<s>sec as named by the enroll tool. Called with emu_lock held.
+static const struct emu_dump *emu_dump(uint32_t decay_ms) {
+    char             path[4096];
+    FILE*            file = NULL;
+    struct emu_dump* dump;
+    uint32_t         i;
+    long             size;
+
+    for (i = 0; i < emu_dumps_count; i++) {
+        if (emu_dumps_loaded[i].decay_ms == decay_ms) {
+            return &emu_dumps_loaded[i];
+        }
+    }
+    if (!emu_dumps || emu_dumps_count == EMU_MAX_DUMPS) {
+        return NULL;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s_%u_%ums", emu_dumps, emu_prefix, emu_iteration, decay_ms);
+    file = fopen(path, "rb");
+    if (!file && decay_ms % 1000 == 0) {
+        snprintf(path, sizeof(path), "%s/%s_%u_%usec", emu_dumps, emu_prefix, emu_iteration, decay_ms / 1000);
+        file = fopen(path, "rb");
+    }
+    if (!file) {
+        puf_be_err("puf-emu: no measurement of %u ms in %s\n", decay_ms, emu_dumps);
+        return NULL;
+    }
+
+    dump = &emu_dumps_loaded[emu_dumps_count];
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    dump->data = size > 0 ? malloc(size) : NULL;
+    if (!dump->data || fread(dump->data, 1, size, file) != (size_t) size) {
+        puf_be_err("puf-emu: failed to read %s\n", path);
+        free(dump->data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    dump->decay_ms = decay_ms;
+    dump->size = size;
+    emu_dumps_count++;
+    emu_log("loaded %s (%ld bytes)\n", path, size);
+    return dump;
+}
+
+// Reads the response of the window from its measurement, like puf_read_window,
+// with each bit flipped with probability PUF_EMU_BER. Called with emu_lock held.
+static int emu_read_window(struct emu_session *session, struct emu_window *window) {
+    const struct emu_dump *dump;
+    uint8_t                bits[32];
+    uint32_t               i;
+    int                    corrected = 0;
+
+    dump = emu_dump(window->enrolled.decay_ms);
+    if (!dump) {
+        return -ENOENT;
+    }
+    for (i = 0; i < 32; i++) {
+        if ((window->enrolled.cells[i].block + 1) * sizeof(uint16_t) > dump->size) {
+            puf_be_err("puf-emu: cell block %u is outside of the measurement\n", window->enrolled.cells[i].block);
+            return -EINVAL;
+        }
+    }
+
+    puf_read_cells(&window->enrolled, dump->data, bits);
+    for (i = 0; i < 32; i++) {
+        if (emu_ber > 0 && rand_r(&emu_seed) < emu_ber * ((double) RAND_MAX + 1)) {
+            bits[i] ^= 0x1;
+            session->flipped++;
+        }
+    }
+
+    if (window->enrolled.parity_len != 0) {
+        if (!emu_rs[window->enrolled.parity_len]) {
+            emu_rs[window->enrolled.parity_len] = init_rs(8, 0x11d, 0, 1, window->enrolled.parity_len);
+            if (!emu_rs[window->enrolled.parity_len]) {
+                return -ENOMEM;
+            }
+        }
+        corrected = puf_correct(emu_rs[window->enrolled.parity_len], &window->enrolled, bits);
+    }
+    if (corrected < 0) {
+        session->failed++;
+    } else {
+        session->corrected += corrected;
+    }
+
+    window->response = puf_bits_to_response(bits);
+    return 0;
+}
+
+// Writers of the response page, see puf_ioctl.h.
+static inline void emu_page_write_begin(struct puf_response_page *page) {
+    __atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void emu_page_write_end(struct puf_response_page *page) {
+    __atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Restarts the windows of the session, like start(). Called with emu_lock held.
+static int emu_start(struct emu_session *session) {
+    uint64_t now;
+    uint32_t i;
+    int      err;
+    struct emu_window *window;
+
+    for (i = 0; i < session->windows_count; i++) {
+        err = emu_read_window(session, &session->windows[i]);
+        if (err) {
+            return err;
+        }
+    }
+
+    // the decay starts once the measurements are loaded.
+    now = puf_be_now_ns();
+    for (i = 0; i < session->windows_count; i++) {
+        window = &session->windows[i];
+        window->deadline_ns = now + (uint64_t) (window->enrolled.decay_ms * 1000000.0 * emu_time_scale);
+        window->read = false;
+    }
+    session->windows_read = 0;
+
+    if (session->page) {
+        emu_page_write_begin(session->page);
+        memset(session->page->windows, 0, session->windows_count * sizeof(struct puf_page_window));
+        session->page->count = session->windows_count;
+        emu_page_write_end(session->page);
+    }
+    pthread_cond_broadcast(&session->wake);
+    return 0;
+}
+
+// Decodes the enrollment into the windows of the session, like parse_enrollment.
+static int emu_enroll(struct emu_session *session, const uint8_t *data, uint32_t count) {
+    uint32_t ptr = 0, n = 0, i, record;
+    struct puf_set set;
+    int err;
+
+    while (ptr < count) {
+        err = puf_parse_set(data, count, &ptr, &set);
+        if (err) {
+            return err;
+        }
+        for (i = 0; i < set.records; i++) {
+            record = puf_record_size(data, count, ptr, &set);
+            if (record == 0) {
+                return -EINVAL;
+            }
+            ptr += record;
+            n++;
+        }
+    }
+    if (n == 0) {
+        return -EINVAL;
+    }
+
+    session->windows = calloc(n, sizeof(struct emu_window));
+    if (!session->windows) {
+        return -ENOMEM;
+    }
+    session->windows_count = n;
+
+    ptr = 0;
+    n = 0;
+    while (n < session->windows_count) {
+        puf_parse_set(data, count, &ptr, &set);
+        for (i = 0; i < set.records; i++) {
+            puf_decode_record(data, &ptr, &set, &session->windows[n++].enrolled);
+        }
+    }
+
+    emu_log("enrolled %u windows\n", session->windows_count);
+    return emu_start(session);
+}
+
+// Earliest deadline of the windows not yet handed to the program, 0 if none.
+// Called with emu_lock held.
+static uint64_t emu_next_deadline(struct emu_session *session) {
+    uint64_t next = 0;
+    uint32_t i;
+
+    for (i = 0; i < session->windows_count; i++) {
+        if (!session->windows[i].read && (next == 0 || session->windows[i].deadline_ns < next)) {
+            next = session->windows[i].deadline_ns;
+        }
+    }
+    return next;
+}
+
+// Blocks until deadline_ns, woken early by close and restarts. Called with emu_lock held.
+static void emu_wait(struct emu_session *session, uint64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec  = deadline_ns / 1000000000ull,
+        .tv_nsec = deadline_ns % 1000000000ull,
+    };
+
+    pthread_cond_timedwait(&session->wake, &emu_lock, &ts);
+}
+
+// Publishes the responses to the page as their windows elapse, like publish_work.
+static void *emu_publish(void *arg) {
+    struct emu_session *session = arg;
+    uint64_t            next;
+    uint32_t            i;
+
+    pthread_mutex_lock(&emu_lock);
+    while (!session->closing) {
+        next = emu_next_deadline(session);
+        if (next == 0 || next > puf_be_now_ns()) {
+            // all published, waits for a restart of the windows.
+            emu_wait(session, next ? next : puf_be_now_ns() + 1000000000ull);
+            continue;
+        }
+
+        for (i = 0; i < session->windows_count; i++) {
+            if (session->windows[i].read || session->windows[i].deadline_ns > puf_be_now_ns()) {
+                continue;
+            }
+            emu_page_write_begin(session->page);
+            __atomic_store_n(&session->page->windows[i].response, session->windows[i].response, __ATOMIC_RELAXED);
+            __atomic_store_n(&session->page->windows[i].ready, 1, __ATOMIC_RELAXED);
+            emu_page_write_end(session->page);
+            session->windows[i].read = true;
+            session->windows_read++;
+        }
+    }
+    pthread_mutex_unlock(&emu_lock);
+    return NULL;
+}
+
+// Returns the elapsed responses, like puf_read. Called with emu_lock held.
+static ssize_t emu_read(struct emu_session *session, void *buf, size_t count) {
+    struct puf_response *responses = buf;
+    uint32_t             capacity  = count / sizeof(struct puf_response);
+    uint32_t             ready     = 0;
+    uint32_t             i;
+    uint64_t             next;
+
+    if (capacity == 0) {
+        return -EINVAL;
+    }
+
+    while (session->windows && session->windows_read < session->windows_count && !session->closing) {
+        next = emu_next_deadline(session);
+        if (next <= puf_be_now_ns()) {
+            break;
+        }
+        if (session->flags & O_NONBLOCK) {
+            return -EAGAIN;
+        }
+        emu_wait(session, next);
+    }
+    if (!session->windows || session->closing) {
+        return 0;
+    }
+
+    for (i = 0; i < session->windows_count && ready < capacity; i++) {
+        if (session->windows[i].read || session->windows[i].deadline_ns > puf_be_now_ns()) {
+            continue;
+        }
+        responses[ready].index = i;
+        responses[ready].response = session->windows[i].response;
+        session->windows[i].read = true;
+        session->windows_read++;
+        ready++;
+    }
+    return ready * sizeof(struct puf_response);
+}
+
+// Maps the response page, like puf_mmap. Called with emu_lock held.
+static void *emu_mmap(struct emu_session *session, void *addr, size_t length, int prot, int flags, off_t offset) {
+    void *view;
+
+    if (!session->windows || offset != 0 || length != PUF_PAGE_SIZE) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    if (prot & PROT_WRITE) {
+        errno = EPERM;
+        return MAP_FAILED;
+    }
+    if (session->windows_count > PUF_PAGE_MAX_WINDOWS) {
+        errno = E2BIG;
+        return MAP_FAILED;
+    }
+
+    if (!session->page) {
+        view = real_mmap(NULL, PUF_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, session->fd, 0);
+        if (view == MAP_FAILED) {
+            return MAP_FAILED;
+        }
+        session->page = view;
+        session->page->count = session->windows_count;
+        if (pthread_create(&session->publisher, NULL, emu_publish, session) == 0) {
+            session->publishing = true;
+        }
+    }
+    return real_mmap(addr, length, prot, flags, session->fd, offset);
+}
+
+static int emu_open(int flags) {
+    struct emu_session *session;
+    int fd;
+
+    fd = memfd_create("puf-emu", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, PUF_PAGE_SIZE) != 0) {
+        real_close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&emu_lock);
+    session = emu_session(-1);
+    if (!session) {
+        pthread_mutex_unlock(&emu_lock);
+        real_close(fd);
+        errno = EBUSY;
+        return -1;
+    }
+    *session = (struct emu_session) {
+        .fd    = fd,
+        .flags = flags,
+    };
+    pthread_cond_init(&session->wake, &emu_condattr);
+    __atomic_add_fetch(&emu_sessions_open, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&emu_lock);
+    return fd;
+}
+
+static bool emu_is_device(const char *path) {
+    emu_resolve();
+    return path && strcmp(path, emu_device) == 0;
+}
+
+EMU_EXPORT int open(const char *path, int flags, ...) {
+    va_list args;
+    mode_t  mode = 0;
+
+    if (emu_is_device(path)) {
+        return emu_open(flags);
+    }
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return real_open(path, flags, mode);
+}
+
+EMU_EXPORT int open64(const char *path, int flags, ...) {
+    va_list args;
+    mode_t  mode = 0;
+
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return open(path, flags, mode);
+}
+
+EMU_EXPORT int openat(int dirfd, const char *path, int flags, ...) {
+    va_list args;
+    mode_t  mode = 0;
+
+    if (emu_is_device(path)) {
+        return emu_open(flags);
+    }
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    return real_openat(dirfd, path, flags, mode);
+}
+
+EMU_EXPORT ssize_t read(int fd, void *buf, size_t count) {
+    struct emu_session *session;
+    ssize_t ret;
+
+    emu_resolve();
+    if (emu_maybe_session(fd)) {
+        pthread_mutex_lock(&emu_lock);
+        session = emu_session(fd);
+        if (session) {
+            session->readers++;
+            ret = emu_read(session, buf, count);
+            session->readers--;
+            pthread_cond_broadcast(&session->wake);
+            pthread_mutex_unlock(&emu_lock);
+            if (ret < 0) {
+                errno = -ret;
+                return -1;
+            }
+            return ret;
+        }
+        pthread_mutex_unlock(&emu_lock);
+    }
+    return real_read(fd, buf, count);
+}
+
+EMU_EXPORT ssize_t write(int fd, const void *buf, size_t count) {
+    struct emu_session *session;
+    int err;
+
+    emu_resolve();
+    if (emu_maybe_session(fd)) {
+        pthread_mutex_lock(&emu_lock);
+        session = emu_session(fd);
+        if (session) {
+            // any write after the enrollment restarts all the windows.
+            err = session->windows ? emu_start(session) : emu_enroll(session, buf, count);
+            pthread_mutex_unlock(&emu_lock);
+            if (err) {
+                errno = -err;
+                return -1;
+            }
+            return count;
+        }
+        pthread_mutex_unlock(&emu_lock);
+    }
+    return real_write(fd, buf, count);
+}
+
+EMU_EXPORT void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    struct emu_session *session;
+    void *ret;
+
+    emu_resolve();
+    if (emu_maybe_session(fd)) {
+        pthread_mutex_lock(&emu_lock);
+        session = emu_session(fd);
+        if (session) {
+            ret = emu_mmap(session, addr, length, prot, flags, offset);
+            pthread_mutex_unlock(&emu_lock);
+            return ret;
+        }
+        pthread_mutex_unlock(&emu_lock);
+    }
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+EMU_EXPORT int ioctl(int fd, unsigned long request, ...) {
+    va_list args;
+    void   *arg;
+
+    emu_resolve();
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    if (emu_maybe_session(fd)) {
+        pthread_mutex_lock(&emu_lock);
+        if (emu_session(fd)) {
+            pthread_mutex_unlock(&emu_lock);
+            switch (request) {
+            case PUF_IOC_FLUSH_CACHE:
+            case PUF_IOC_PREDECAY_REGISTER:
+            case PUF_IOC_PREDECAY_CLEAR:
+                return 0;
+            default:
+                errno = ENOTTY;
+                return -1;
+            }
+        }
+        pthread_mutex_unlock(&emu_lock);
+    }
+    return real_ioctl(fd, request, arg);
+}
+
+EMU_EXPORT int close(int fd) {
+    struct emu_session *session;
+    pthread_t           publisher;
+    bool                publishing;
+
+    emu_resolve();
+    if (!emu_maybe_session(fd)) {
+        return real_close(fd);
+    }
+
+    pthread_mutex_lock(&emu_lock);
+    session = emu_session(fd);
+    if (!session) {
+        pthread_mutex_unlock(&emu_lock);
+        return real_close(fd);
+    }
+
+    // blocked readers return 0 and the publisher exits, the entry is released after.
+    session->closing = true;
+    pthread_cond_broadcast(&session->wake);
+    while (session->readers != 0) {
+        pthread_cond_wait(&session->wake, &emu_lock);
+    }
+    publishing = session->publishing;
+    publisher = session->publisher;
+    pthread_mutex_unlock(&emu_lock);
+
+    if (publishing) {
+        pthread_join(publisher, NULL);
+    }
+
+    pthread_mutex_lock(&emu_lock);
+    emu_log("%u/%u windows read, %llu bits flipped, %llu symbols corrected, %llu windows failed\n",
+            session->windows_read, session->windows_count, (unsigned long long) session->flipped,
+            (unsigned long long) session->corrected, (unsigned long long) session->failed);
+    if (session->page) {
+        munmap(session->page, PUF_PAGE_SIZE);
+    }
+    free(session->windows);
+    pthread_cond_destroy(&session->wake);
+    session->fd = -1;
+    __atomic_sub_fetch(&emu_sessions_open, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&emu_lock);
+
+    return real_close(fd);
+}
@@ -7,26 +7,16 @@
 #include <linux/gfp.h>
 #include <linux/dma-mapping.h>
 
-#define CNTRL_MOD_REG               0x44E10000                // Control Module registers offset.
-#define BANDGAP_CTRL                CNTRL_MOD_REG + 0x0448    // Bandgap control register for reading temperature.
-#define BANDGAP_CTRL_DTEMP_OFF      8                         // Offset for temperature reading.
-#define BANDGAP_CTRL_DTEMP_MASK     0x0000FF00                // Bits used for temperature.
-#define BANDGAP_CTRL_TMPOFF         BIT(5)
-#define BANDGAP_CTRL_SOC            BIT(4)                    
-#define BANDGAP_CTRL_CLRZ           BIT(3)
-#define BANDGAP_CTRL_CONTCONV       BIT(2)
+// Register windows and software refresh shared with the puf module.
+#include "hw_regs.h"
+#include "refresh.h"
 
 #define TEMP_POLL_PERIOD        2                             // Number of seconds between individual temperature reads.
 
-#define EMIF0_REG               0x4C000000                    // EMIF0 register base.
-#define SDRAM_REF_CTRL          EMIF0_REG + 0x10              // Offset for the register of the SDRAM REFRESH CONTROL register.
-#define SDRAM_REF_CTRL_SDHW     EMIF0_REG + 0x14              // Offset for shadow register of the SDRAM REFRESH CONTROL register.
-
 #define DDR_END                 0x9fdfffff                    // SDRAM end for CPU.
 #define DDR_BASE                0x80000000                    // SDRAM base for CPU.
 
 #define REFRESH_PERIOD          55                            // Refresh period for custom SDRAM refresh.
-#define DISABLE_REFRESH         BIT(31)                       // Bit to flip to disable/enable SDRAM refresh.
 
 #define ROW_SIZE                sizeof(unsigned int) * (1<<9) // word_size * page size
 
@@ -42,65 +32,16 @@ module_param(puf_block_2, uint, 0);
 module_param(puf_block_1_size, uint, 0);
 module_param(puf_block_2_size, uint, 0);
 
+// Software refresh, see common/refresh.h.
+static struct refresh_range  sdram_excluded[2];
+static struct refresh_engine sdram_engine;
+static struct refresh_runner sdram_runner;
+
 uint32_t temp_total      = 0x0;
 uint32_t temp_poll_count = 0x0;
 
-static struct delayed_work work_sdram;
 static struct delayed_work work_temp_poll;
 
-int hw_reg_r32(uint32_t addr, uint32_t *out) {
-    uint32_t *virt_addr = (uint32_t *) ioremap(addr, sizeof(uint32_t));
-    if (!virt_addr) {
-        printk(KERN_ERR "failed to read physical address=0x%08x\n", addr);
-        return -1;
-    }
-
-    *out = *virt_addr;
-    iounmap((void *) virt_addr);
-
-    return 0;
-}
-
-int hw_reg_w32(uint32_t addr, uint32_t val) {
-    uint32_t *virt_addr = (uint32_t *) ioremap(addr, sizeof(uint32_t));
-    if (!virt_addr) {
-        printk(KERN_ERR "failed to read physical address=0x%08x\n", addr);
-        return -1;
-    }
-
-    *virt_addr = val;
-    iounmap((void *) virt_addr);
-
-    return 0;
-}
-
-#pragma GCC push_options
-#pragma GCC optimize ("O2")
-int phys_r32(uint32_t addr, uint32_t *out) {
-    uint32_t *virt_addr = (uint32_t *) phys_to_virt(addr);
-    if (!virt_addr) {
-        printk(KERN_ERR "failed to read physical address=0x%08x\n", addr);
-        return -1;
-    }
-
-    *out = *virt_addr;
-
-    return 0;
-}
-
-int phys_w32(uint32_t addr, uint32_t value) {
-    uint32_t *virt_addr = (uint32_t *) phys_to_virt(addr);
-    if (!virt_addr) {
-        printk(KERN_ERR "failed to read physical address=0x%08x\n", addr);
-        return -1;
-    }
-
-    *virt_addr = value;
-
-    return 0;
-}
-#pragma GCC pop_options
-
 void temp_polling(struct work_struct *work) {
     uint32_t tctrl, temp;
     struct delayed_work *dwork;
@@ -116,33 +57,23 @@ void temp_polling(struct work_struct *work) {
     temp_poll_count += 1;
 }
 
-void sdram_refresh(struct work_struct *work) {
-    uint32_t discard, offset;
-    uint32_t puf_block_1_beg, puf_block_1_end;
-    uint32_t puf_block_2_beg, puf_block_2_end;
+// Sets up the software refresh of the SDRAM outside of the PUF blocks.
+int init_sdram_refresh(void) {
+    uint32_t count = 0;
 
-    struct delayed_work *dwork;
-
-    dwork = to_delayed_work(work);
-    schedule_delayed_work(dwork, msecs_to_jiffies(REFRESH_PERIOD));
-
-    puf_block_1_beg = puf_block_1;
-    puf_block_1_end = puf_block_1 + puf_block_1_size;
-
-    puf_block_2_beg = puf_block_2;
-    puf_block_2_end = puf_block_2 + puf_block_2_size;
-
-    for (offset = DDR_BASE; offset <= DDR_END; offset += ROW_SIZE) {
-        if (offset >= puf_block_1_beg && offset < puf_block_1_end) {
-            offset = puf_block_1_end - ROW_SIZE;
-            continue;
-        }
-        if (offset >= puf_block_2_beg && offset < puf_block_2_end) {
-            offset = puf_block_2_end - ROW_SIZE;
-            continue;
-        }
-        phys_r32(offset, &discard);
+    if (puf_block_1 != 0x0) {
+        sdram_excluded[count].beg = puf_block_1;
+        sdram_excluded[count].end = puf_block_1 + puf_block_1_size;
+        count++;
+    }
+    if (puf_block_2 != 0x0) {
+        sdram_excluded[count].beg = puf_block_2;
+        sdram_excluded[count].end = puf_block_2 + puf_block_2_size;
+        count++;
     }
+
+    return refresh_setup(&sdram_runner, &sdram_engine, DDR_BASE, DDR_END + 1, (uint8_t *) phys_to_virt(DDR_BASE),
+                         ROW_SIZE, sdram_excluded, count, REFRESH_PERIOD);
 }
 
 void disable_sdram_refresh(void) {
@@ -191,7 +122,9 @@ void zero(uint32_t phys_addr, uint32_t size) {
     memset(virt_addr, 0, size);
 }
 
-void start_puf(void) {
+int start_puf(void) {
+    int err;
+
     if (puf_block_1 != 0x0) {
         zero(puf_block_1, puf_block_1_size);
     }
@@ -200,8 +133,15 @@ void start_puf(void) {
         zero(puf_block_2, puf_block_2_size);
     }
 
+    // the software refresh has to run before the hardware one is disabled.
+    err = refresh_start(&sdram_runner);
+    if (err) {
+        printk(KERN_ERR "failed to start the software refresh\n");
+        return err;
+    }
     disable_sdram_refresh();
-    schedule_delayed_work(&work_sdram, msecs_to_jiffies(REFRESH_PERIOD));
+
+    return 0;
 }
 
 void start_temp_polling(void) {
@@ -223,19 +163,37 @@ void stop_temp_polling(void) {
 
     printk(KERN_INFO "Temp Total=%d\n", temp_total);
     printk(KERN_INFO "Poll count=%d\n", temp_poll_count);
+    // the reference temperature of the enrollment, see decay_config.temperature.
+    if (temp_poll_count != 0) {
+        printk(KERN_INFO "Temp Avg=%d\n", temp_total / temp_poll_count);
+    }
 }
 
 void end_puf(void) {
     enable_sdram_refresh();
-    cancel_delayed_work_sync(&work_sdram);
+    refresh_stop(&sdram_runner);
 }
 
 static int __init puf_start(void) {
-    INIT_DELAYED_WORK(&work_sdram, sdram_refresh);
+    int err;
+
     INIT_DELAYED_WORK(&work_temp_poll, temp_polling);
 
+    err = hw_regs_map();
+    if (err) {
+        printk(KERN_ERR "failed to map the EMIF0 and control module registers\n");
+        return err;
+    }
+
+    err = init_sdram_refresh();
+    if (!err) {
+        err = start_puf();
+    }
+    if (err) {
+        hw_regs_unmap();
+        return err;
+    }
     start_temp_polling();
-    start_puf();
 
     return 0;
 }
@@ -243,6 +201,7 @@ static int __init puf_start(void) {
 static void __exit puf_end(void) {
     end_puf();
     stop_temp_polling();
+    hw_regs_unmap();
 }
 
 module_init(puf_start);
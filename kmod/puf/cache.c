@@ -0,0 +1,158 @@
+// Cache of the decoded responses keyed by their enrollment record, so that a
+// restarted process presenting the same enrollment does not wait for the decay again.
+// Off unless cache_ttl_ms is set.
+
+#define PUF_CACHE_BITS          6                             // 64 buckets.
+#define PUF_CACHE_MAX_ENTRIES   256                           // Oldest entries are evicted beyond this.
+
+static uint32_t cache_ttl_ms = 0;
+module_param(cache_ttl_ms, uint, 0644);
+MODULE_PARM_DESC(cache_ttl_ms, "milliseconds a decoded response is served from the cache, 0 disables the cache (default)");
+
+struct puf_cache_entry {
+    struct hlist_node node;       // bucket of the key.
+    struct list_head  age;        // entries ordered from the oldest.
+    uint32_t          key;        // jhash of the record.
+    uint32_t          response;
+    ktime_t           stored;
+    uint16_t          record_len;
+    uint8_t           record[];   // enrollment record the response was decoded for.
+};
+
+static DEFINE_HASHTABLE(puf_cache, PUF_CACHE_BITS);
+static LIST_HEAD(puf_cache_age);
+static DEFINE_MUTEX(cache_lock);
+
+uint32_t cache_entries = 0x0;
+uint64_t cache_hits    = 0x0;   // both only accessed under cache_lock.
+uint64_t cache_misses  = 0x0;
+
+uint32_t cache_key(const uint8_t *record, uint16_t record_len) {
+    return jhash(record, record_len, 0);
+}
+
+void cache_evict(struct puf_cache_entry *entry) {
+    hash_del(&entry->node);
+    list_del(&entry->age);
+    kfree(entry);
+    cache_entries--;
+}
+
+// Drops the entries older than the TTL, called with the cache locked.
+void cache_expire(void) {
+    struct puf_cache_entry *entry, *next;
+    ktime_t now = ktime_get();
+
+    list_for_each_entry_safe(entry, next, &puf_cache_age, age) {
+        if (cache_ttl_ms != 0 && ktime_ms_delta(now, entry->stored) < cache_ttl_ms) {
+            break;
+        }
+        cache_evict(entry);
+    }
+}
+
+struct puf_cache_entry *cache_find(const uint8_t *record, uint16_t record_len, uint32_t key) {
+    struct puf_cache_entry *entry;
+
+    hash_for_each_possible(puf_cache, entry, node, key) {
+        if (entry->key == key && entry->record_len == record_len
+            && memcmp(entry->record, record, record_len) == 0) {
+            return entry;
+        }
+    }
+
+    return 0x0;
+}
+
+bool cache_lookup(const uint8_t *record, uint16_t record_len, uint32_t key, uint32_t *response) {
+    struct puf_cache_entry *entry;
+
+    if (!record) {
+        return false;
+    }
+
+    mutex_lock(&cache_lock);
+    cache_expire();
+    entry = cache_find(record, record_len, key);
+    if (entry) {
+        *response = entry->response;
+        cache_hits++;
+    } else {
+        cache_misses++;
+    }
+    mutex_unlock(&cache_lock);
+
+    return entry != 0x0;
+}
+
+void cache_insert(const uint8_t *record, uint16_t record_len, uint32_t key, uint32_t response) {
+    struct puf_cache_entry *entry;
+
+    if (!record || cache_ttl_ms == 0) {
+        return;
+    }
+
+    mutex_lock(&cache_lock);
+    entry = cache_find(record, record_len, key);
+    if (entry) {
+        list_del(&entry->age);
+    } else {
+        if (cache_entries == PUF_CACHE_MAX_ENTRIES) {
+            cache_evict(list_first_entry(&puf_cache_age, struct puf_cache_entry, age));
+        }
+        entry = kmalloc(sizeof(struct puf_cache_entry) + record_len, GFP_KERNEL);
+        if (!entry) {
+            mutex_unlock(&cache_lock);
+            return;
+        }
+        entry->key = key;
+        entry->record_len = record_len;
+        memcpy(entry->record, record, record_len);
+        hash_add(puf_cache, &entry->node, key);
+        cache_entries++;
+    }
+    entry->response = response;
+    entry->stored = ktime_get();
+    list_add_tail(&entry->age, &puf_cache_age);
+    mutex_unlock(&cache_lock);
+}
+
+void cache_flush(void) {
+    struct puf_cache_entry *entry, *next;
+
+    mutex_lock(&cache_lock);
+    list_for_each_entry_safe(entry, next, &puf_cache_age, age) {
+        cache_evict(entry);
+    }
+    mutex_unlock(&cache_lock);
+}
+
+// Statistics under /sys/class/misc/puf/.
+static ssize_t cache_hits_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    uint64_t count;
+
+    // a 64bit load may tear on 32bit ARM, read it under the lock that updates it.
+    mutex_lock(&cache_lock);
+    count = cache_hits;
+    mutex_unlock(&cache_lock);
+
+    return sysfs_emit(buf, "%llu\n", count);
+}
+
+static ssize_t cache_misses_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    uint64_t count;
+
+    mutex_lock(&cache_lock);
+    count = cache_misses;
+    mutex_unlock(&cache_lock);
+
+    return sysfs_emit(buf, "%llu\n", count);
+}
+
+static ssize_t cache_entries_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%u\n", cache_entries);
+}
+
+static DEVICE_ATTR_RO(cache_hits);
+static DEVICE_ATTR_RO(cache_misses);
+static DEVICE_ATTR_RO(cache_entries);
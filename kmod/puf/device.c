@@ -1,202 +1,904 @@
-unsigned int PID              = 0;
-uint8_t*     enrollment_data  = 0x0;
-uint32_t     enrollment_ptr   = 0x0; // points to elements to enrollment_data
+struct puf_slot;
+
+// A decay window of the enrollment, one per PUF response requested by the program,
+// decoded from its enrollment record when the enrollment is written.
+struct puf_window {
+    struct puf_record enrolled;             // decoded enrollment record, see puf_core.h.
+    bool            ready;                  // the decay time elapsed, set by the timer.
+    bool            read;                   // the response was already handed to the program.
+    struct hrtimer  timer;                  // fires once the decay time elapsed.
+    struct puf_slot* slot;                  // slot the window decays in.
+    uint8_t*        record;                 // copy of the enrollment record, the cache key. NULL if not cached.
+    uint16_t        record_len;
+    uint32_t        key;                    // hash of the record.
+    bool            cached;                 // the response was served from the cache, the window does not decay.
+    uint32_t        response;               // the cached response.
+};
 
-void device_cleanup(void) {
-    end_puf();
+// A decay slot, an equal share of the PUF region with its own enrollment, decay
+// windows and readers. The slots are aligned to the DRAM rows so that resetting or
+// reading one slot never touches (and refreshes) the rows of another one.
+struct puf_slot {
+    uint32_t           index;
+    uint32_t           offset;         // byte offset of the slot within the PUF region.
+    uint32_t           size;           // size of the slot in bytes.
+    uint8_t            state;          // PUF_UNUSED or PUF_WAITING_FOR_READ.
+    unsigned int       pid;            // process the slot is enrolled by, 0 if free.
+    bool               decaying;       // holds a reference on the disabled hardware refresh.
+    struct puf_window* windows;
+    uint32_t           windows_count;
+    uint32_t           windows_read;
+    struct mutex       lock;
+    wait_queue_head_t  wait;           // readers blocked until the next window is ready.
+
+    // pre-decay of a registered enrollment, see predecay.c.
+    uint8_t*            predecay_data;  // registered enrollment, NULL if none.
+    uint32_t            predecay_len;
+    bool                predecaying;    // the windows belong to a background pre-decay cycle.
+    struct delayed_work predecay_work;
+
+    ktime_t            enrolled_at;    // start of the session of the process.
+    bool               predecayed;     // the session was served by the pre-decay (cached or adopted).
+
+    // response page mapped by the process, see puf_mmap().
+    struct puf_response_page* page;         // NULL until mapped.
+    struct work_struct        publish_work; // publishes the elapsed windows to the page.
+};
+
+// Time from the enrollment until the last response was read, of the
+// sessions served by the pre-decay and of the ones that decayed in full.
+struct unlock_stats {
+    uint32_t count;
+    uint64_t total_ms;
+    uint64_t max_ms;
+};
+
+struct unlock_stats unlock_cold      = {0};
+struct unlock_stats unlock_predecay  = {0};
+static DEFINE_MUTEX(unlock_lock);
+
+struct puf_slot slots[PUF_MAX_SLOTS];
+
+// Number of open sessions, at most one per slot.
+uint32_t sessions = 0x0;
+static DEFINE_MUTEX(slots_lock);
 
-    if (PID != 0) {
-        printk(KERN_INFO "PID %d stopped using PUF\n", PID);
-        PID = 0;
+// Reed Solomon control structures indexed by the parity length, built on the first
+// enrollment using the parity length and shared by all slots until the module is unloaded.
+struct rs_control* rs_controls[PUF_MAX_PARITY + 1] = {0x0};
+static DEFINE_MUTEX(rs_lock);
+
+void publish_work(struct work_struct *work);
+
+enum hrtimer_restart window_elapsed(struct hrtimer *timer) {
+    struct puf_window *window = container_of(timer, struct puf_window, timer);
+
+    WRITE_ONCE(window->ready, true);
+    wake_up_interruptible(&window->slot->wait);
+
+    // the cells are read in process context, right away.
+    if (READ_ONCE(window->slot->page)) {
+        queue_work(system_highpri_wq, &window->slot->publish_work);
     }
 
-    if (enrollment_data != 0x0) {
-        printk(KERN_INFO "freeing enrollment_data\n");
-        kfree(enrollment_data);
-        enrollment_data = 0x0;
-        enrollment_ptr  = 0x0;
+    return HRTIMER_NORESTART;
+}
+
+void init_slots(void) {
+    uint32_t i;
+
+    for (i = 0; i < puf_slots; i++) {
+        slots[i].index = i;
+        puf_slot_range(puf_size, puf_slots, i, &slots[i].offset, &slots[i].size);
+        slots[i].state = PUF_UNUSED;
+        mutex_init(&slots[i].lock);
+        init_waitqueue_head(&slots[i].wait);
+        INIT_WORK(&slots[i].publish_work, publish_work);
     }
-    puf_state = PUF_UNUSED;
+}
+
+int init_rs_controls(struct puf_window *windows, uint32_t windows_count) {
+    uint32_t i;
+    uint8_t  parity;
+
+    mutex_lock(&rs_lock);
+    for (i = 0; i < windows_count; i++) {
+        parity = windows[i].enrolled.parity_len;
+        if (rs_controls[parity]) {
+            continue;
+        }
+        rs_controls[parity] = init_rs(8, 0x11d, 0, 1, parity); // use same params as when encoding.
+        if (!rs_controls[parity]) {
+            mutex_unlock(&rs_lock);
+            return -ENOMEM;
+        }
+    }
+    mutex_unlock(&rs_lock);
+
+    return 0;
+}
+
+void free_rs_controls(void) {
+    uint32_t i;
+
+    for (i = 0; i <= PUF_MAX_PARITY; i++) {
+        if (rs_controls[i]) {
+            free_rs(rs_controls[i]);
+            rs_controls[i] = 0x0;
+        }
+    }
+}
+
+void stop_windows(struct puf_slot *slot) {
+    uint32_t i;
+
+    for (i = 0; i < slot->windows_count; i++) {
+        hrtimer_cancel(&slot->windows[i].timer);
+    }
+}
+
+// true if a read would not block, either a window is ready to be read or
+// there is nothing left to wait for.
+bool window_pending(struct puf_slot *slot) {
+    uint32_t i;
+
+    if (slot->state != PUF_WAITING_FOR_READ || slot->windows_read == slot->windows_count) {
+        return true;
+    }
+
+    for (i = 0; i < slot->windows_count; i++) {
+        if (!slot->windows[i].read && READ_ONCE(slot->windows[i].ready)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void free_windows(struct puf_window *windows, uint32_t windows_count) {
+    uint32_t i;
+
+    for (i = 0; i < windows_count; i++) {
+        hrtimer_cancel(&windows[i].timer);
+        kfree(windows[i].record);
+    }
+    kfree(windows);
+}
+
+// Frees the windows of the slot and enables the hardware refresh
+// if nothing else decays, called with the slot locked.
+void clear_slot(struct puf_slot *slot) {
+    if (slot->windows != 0x0) {
+        printk(KERN_INFO "slot %u: freeing enrollment\n", slot->index);
+        free_windows(slot->windows, slot->windows_count);
+        slot->windows       = 0x0;
+        slot->windows_count = 0x0;
+        slot->windows_read  = 0x0;
+    }
+
+    if (slot->decaying) {
+        put_puf();
+        slot->decaying = false;
+    }
+    slot->state = PUF_UNUSED;
+}
+
+// Frees the enrollment of the slot and hands the slot back, called with the slot locked.
+void release_slot(struct puf_slot *slot) {
+    struct puf_response_page *page;
+
+    clear_slot(slot);
+
+    if (slot->pid != 0) {
+        printk(KERN_INFO "PID %d stopped using PUF slot %u\n", slot->pid, slot->index);
+    }
+    wake_up_interruptible(&slot->wait);
+
+    // the mapping of the process keeps its own reference on the page.
+    if (slot->page) {
+        page = slot->page;
+        WRITE_ONCE(slot->page, 0x0);
+        free_page((unsigned long) page);
+    }
+
+    // the slot can be claimed again only once it is empty.
+    mutex_lock(&slots_lock);
+    slot->pid = 0;
+    mutex_unlock(&slots_lock);
+}
+
+void device_cleanup(void) {
+    uint32_t i;
+
+    for (i = 0; i < puf_slots; i++) {
+        mutex_lock(&slots[i].lock);
+        release_slot(&slots[i]);
+        mutex_unlock(&slots[i].lock);
+        cancel_work_sync(&slots[i].publish_work);
+    }
+    free_rs_controls();
+    cache_flush();
     printk(KERN_INFO "device: cleanup ok, PUF is now unused\n");
 }
 
-void start(void) {
-    memset(puf_addr, 0, puf_size);
-    puf_state = PUF_WAITING_FOR_READ;
-    start_puf();
+// Writers of the response page, serialized by the slot lock.
+static inline void page_write_begin(struct puf_response_page *page) {
+    WRITE_ONCE(page->seq, page->seq + 1);
+    smp_wmb();
+}
+
+static inline void page_write_end(struct puf_response_page *page) {
+    smp_store_release(&page->seq, page->seq + 1);
+}
+
+// Clears the responses of the page for a new session of the windows, called with the slot locked.
+void reset_page(struct puf_slot *slot) {
+    struct puf_response_page *page = slot->page;
+
+    if (!page) {
+        return;
+    }
+
+    page_write_begin(page);
+    memset(page->windows, 0, slot->windows_count * sizeof(struct puf_page_window));
+    WRITE_ONCE(page->count, slot->windows_count);
+    page_write_end(page);
+}
+
+// Resets the cells of the slot and restarts all of its windows, called with the slot locked.
+int start(struct puf_slot *slot) {
+    uint32_t i;
+    uint32_t decaying = 0;
+    uint32_t decay_ms;
+    error err;
+    struct puf_window *window;
+
+    stop_windows(slot);
+    for (i = 0; i < slot->windows_count; i++) {
+        window = &slot->windows[i];
+        // a pre-decay cycle decays every window so that its entries are refreshed before they expire.
+        window->cached = !slot->predecaying &&
+                         cache_lookup(window->record, window->record_len, window->key, &window->response);
+        window->ready = window->cached;
+        window->read = false;
+        if (!window->cached) {
+            decaying++;
+        }
+    }
+    slot->windows_read = 0;
+    reset_page(slot);
+
+    if (decaying != 0) {
+        puf_clear_slot(puf_addr, slot->offset, slot->size);
+
+        // the hardware refresh stays disabled while any slot decays.
+        if (!slot->decaying) {
+            err = get_puf();
+            if (err) {
+                return err;
+            }
+            slot->decaying = true;
+        }
+    }
+    slot->state = PUF_WAITING_FOR_READ;
+
+    // all windows of the slot decay within this single refresh-disabled
+    // session and are timed from the same start, scaled to the current temperature.
+    for (i = 0; i < slot->windows_count; i++) {
+        window = &slot->windows[i];
+        if (!window->cached) {
+            decay_ms = compensate_decay(window->enrolled.decay_ms, window->enrolled.reference_temp,
+                                        window->enrolled.halving);
+            puf_dbg("debug: slot %u window %u decays %u ms (enrolled %u ms)\n",
+                    slot->index, i, decay_ms, window->enrolled.decay_ms);
+            hrtimer_start(&window->timer, ms_to_ktime(decay_ms), HRTIMER_MODE_REL);
+        }
+    }
+
+    // the cached responses can be read right away.
+    if (decaying != slot->windows_count) {
+        wake_up_interruptible(&slot->wait);
+        if (slot->page) {
+            queue_work(system_highpri_wq, &slot->publish_work);
+        }
+    }
+
+    return 0;
+}
+
+// Decodes the enrollment data into its decay windows. The enrollment consists of
+// one or more sets, each a header followed by its records, see puf_core.h.
+// The index of a window is the position of its record across all sets.
+int parse_enrollment(uint8_t *data, uint32_t count, struct puf_window **out, uint32_t *out_count) {
+    uint32_t ptr       = 0x0;
+    uint32_t n         = 0x0;
+    uint32_t i         = 0x0;
+    uint32_t record    = 0x0;
+    uint32_t windows_count = 0x0;
+    struct puf_set     set;
+    struct puf_window *windows;
+    struct puf_window *window;
+    error err;
+
+    // first pass validates the sets and counts the records.
+    while (ptr < count) {
+        err = puf_parse_set(data, count, &ptr, &set);
+        if (err) {
+            return err;
+        }
+        for (i = 0; i < set.records; i++) {
+            record = puf_record_size(data, count, ptr, &set);
+            if (record == 0) {
+                return -EINVAL;
+            }
+            // the cells are read from the PUF mapping as they are.
+            if (puf_record_cells_end(data, ptr, record) > puf_size) {
+                printk(KERN_ERR "enrollment record %u points to cells outside of the PUF\n", n);
+                return -EINVAL;
+            }
+            ptr += record;
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return -EINVAL;
+    }
+
+    windows = (struct puf_window *) kcalloc(n, sizeof(struct puf_window), GFP_KERNEL);
+    if (!windows) {
+        return -ENOMEM;
+    }
+
+    ptr = 0x0;
+    windows_count = 0x0;
+    while (windows_count < n) {
+        puf_parse_set(data, count, &ptr, &set);
+
+        for (i = 0; i < set.records; i++) {
+            window = &windows[windows_count++];
+            hrtimer_init(&window->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+            window->timer.function = window_elapsed;
+            // only kept when caching, as the key of the cached response.
+            if (cache_ttl_ms != 0) {
+                record = puf_record_size(data, count, ptr, &set);
+                window->record = kmemdup(&data[ptr], record, GFP_KERNEL);
+                if (!window->record) {
+                    free_windows(windows, windows_count);
+                    return -ENOMEM;
+                }
+                window->record_len = record;
+                window->key = cache_key(&data[ptr], record);
+            }
+            puf_decode_record(data, &ptr, &set, &window->enrolled);
+        }
+    }
+
+    *out = windows;
+    *out_count = windows_count;
+    return 0;
+}
+
+// Finds the slot holding all the cells of the enrollment, the enrollment
+// has to be generated against the cells of a single slot.
+struct puf_slot *find_slot(struct puf_window *windows, uint32_t windows_count) {
+    uint32_t i;
+    uint32_t beg = U32_MAX;
+    uint32_t end = 0x0;
+    int      slot;
+
+    for (i = 0; i < windows_count; i++) {
+        puf_record_span(&windows[i].enrolled, &beg, &end);
+    }
+
+    // the slots split the region equally, see init_slots.
+    slot = puf_find_slot(beg, end, puf_size / puf_slots, puf_slots);
+    return slot < 0 ? 0x0 : &slots[slot];
 }
 
+// A session waits for its enrollment (private_data is NULL) until the enrollment
+// binds it to the slot its cells belong to.
 static int puf_open(struct inode *inode, struct file *file) {
     printk(KERN_INFO "puf opened by process with PID: %d\n", current->pid);
     if (puf_state == PUF_WARM_UP) {
 	printk(KERN_INFO "PUF is in warm up stage, closing %d\n", current->pid);
         return -1;
     }
-    if (PID == 0) {
-        PID = current->pid;
-        puf_state = PUF_WAITING_FOR_ENROLLMENT;
-        printk(KERN_INFO "PUF waiting for enrollment data\n");
-    } else {
-        printk(KERN_ERR "%d trying to open PUF already beloning to %d\n", current->pid, PID);
-        return -1;
+
+    mutex_lock(&slots_lock);
+    if (sessions == puf_slots) {
+        mutex_unlock(&slots_lock);
+        printk(KERN_ERR "%d trying to open PUF with all %u slots in use\n", current->pid, puf_slots);
+        return -EBUSY;
     }
+    sessions++;
+    mutex_unlock(&slots_lock);
+
+    file->private_data = 0x0;
+    printk(KERN_INFO "PUF waiting for enrollment data\n");
     return 0;
 }
 
 static int puf_release(struct inode * inode, struct file *file) {
-    device_cleanup();
+    struct puf_slot *slot = file->private_data;
+
+    if (slot) {
+        mutex_lock(&slot->lock);
+        release_slot(slot);
+        mutex_unlock(&slot->lock);
+    }
+
+    mutex_lock(&slots_lock);
+    sessions--;
+    mutex_unlock(&slots_lock);
     return 0;
 }
 
-static ssize_t puf_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+void record_unlock(struct puf_slot *slot) {
+    uint64_t ms = ktime_ms_delta(ktime_get(), slot->enrolled_at);
+    struct unlock_stats *stats = slot->predecayed ? &unlock_predecay : &unlock_cold;
+
+    mutex_lock(&unlock_lock);
+    stats->count++;
+    stats->total_ms += ms;
+    stats->max_ms = max(stats->max_ms, ms);
+    mutex_unlock(&unlock_lock);
+
+    printk(KERN_INFO "PID %d unlocked PUF slot %u in %llu ms%s\n", slot->pid, slot->index, ms,
+           slot->predecayed ? " (pre-decayed)" : "");
+}
+
+// Reconstructs the 32bit response of a single decay window.
+int puf_read_window(struct puf_slot *slot, struct puf_window *window, uint32_t *response) {
     uint32_t            i                  = 0;
-    uint32_t            response           = 0x0;
-    uint32_t            block_ptr          = 0x0;
-    uint32_t            block              = 0x0;
-    uint32_t            mask               = 0x0;
-    uint16_t            memory             = 0x0;
-    uint32_t            memory_offset      = 0x0;
-    uint8_t             parity             = 0x0;
-    uint16_t*           parity_array       = 0x0;
     uint8_t             recovered_bits[32] = {0x0};
-    struct rs_control*	rs_ctrl            = 0x0;
+    struct rs_control*	rs_ctrl            = rs_controls[window->enrolled.parity_len];
+    int                 corrected          = 0;
+    ktime_t             read_start         = 0;
+
+    if (trace_puf_read_window_enabled()) {
+        read_start = ktime_get();
+    }
 
-    if (puf_state == PUF_WAITING_FOR_READ) {
-        parity = consume_8bits_be(&enrollment_ptr, enrollment_data);
-        parity_array = (uint16_t *) kzalloc(parity * sizeof(uint16_t), GFP_KERNEL);
-        rs_ctrl = init_rs(8, 0x11d, 0, 1, parity); // use same params as when encoding.
+    puf_read_cells(&window->enrolled, puf_addr, recovered_bits);
 
-        for (i= 0; i < parity; i++) {
-            parity_array[i] = consume_16bits_be(&enrollment_ptr, enrollment_data);
-            printk(KERN_INFO "debug: parity[%d]:%d\n", i, parity_array[i]);
+    if (debug) {
+        printk(KERN_INFO "debug: recovered bits - ");
+        for (i = 0; i < 32; i++) {
+            printk(KERN_CONT " %02x", recovered_bits[i]);
         }
+        printk(KERN_CONT "\n");
+    }
+
+    // TODO: handle error correctly.
+    corrected = puf_correct(rs_ctrl, &window->enrolled, recovered_bits);
+    if (corrected < 0) {
+        printk(KERN_ERR "failed to apply ECC\n");
+    }
 
+    if (debug) {
+        printk(KERN_INFO "bits after ECC: ");
         for (i = 0; i < 32; i++) {
-	    block_ptr = consume_32bits_be(&enrollment_ptr, enrollment_data);
+            printk(KERN_CONT " %02x", recovered_bits[i]);
+        }
+        printk(KERN_CONT "\n");
+    }
 
-            block = block_ptr >> 4;
-            mask = block_ptr & 0xf;
-            memory_offset = block * sizeof(uint16_t);
+    *response = puf_bits_to_response(recovered_bits);
 
-            printk(KERN_INFO "debug: block:%u mask: %u ptr: %u memoffset: %u", block, mask, block_ptr, memory_offset);
+    puf_dbg("debug: reconstructed response - %u(hex: 0x%08x)\n", *response, *response);
 
-            if (va_phys_r16_be(puf_phys_addr + memory_offset, &memory) != 0) {
-                printk(KERN_ERR "failed to read physical RAM, aborting PUF read\n");
-                kfree(parity_array);
-                free_rs(rs_ctrl);
-                return -EFAULT;
-            }
+    if (corrected >= 0) {
+        cache_insert(window->record, window->record_len, window->key, *response);
+    }
 
-            printk(KERN_CONT " value at address:%d\n", memory);
+    if (trace_puf_read_window_enabled()) {
+        trace_puf_read_window(slot->index, window - slot->windows,
+                              ktime_to_ns(ktime_sub(ktime_get(), read_start)), corrected);
+    }
 
-            if ((memory & (1 << mask)) != 0x0) {
-                recovered_bits[i] = 0x1;
-            }
+    return 0;
+}
+
+// Returns every response whose decay window has elapsed since the last read,
+// as an array of struct puf_response. Blocks until at least one window is ready
+// unless opened with O_NONBLOCK. Returns 0 once all windows were read.
+static ssize_t puf_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+    uint32_t             i         = 0;
+    uint32_t             ready     = 0;
+    uint32_t             capacity  = 0;
+    ssize_t              ret       = 0;
+    struct puf_response* responses = 0x0;
+    struct puf_slot*     slot      = file->private_data;
+    struct puf_window*   windows   = 0x0;
+
+    capacity = count / sizeof(struct puf_response);
+    if (capacity == 0) {
+        return -EINVAL;
+    }
+
+    // not enrolled yet, there is nothing to wait for.
+    if (!slot) {
+        return 0;
+    }
+
+    mutex_lock(&slot->lock);
+
+    while (!window_pending(slot)) {
+        mutex_unlock(&slot->lock);
+        if (file->f_flags & O_NONBLOCK) {
+            return -EAGAIN;
         }
+        if (wait_event_interruptible(slot->wait, window_pending(slot))) {
+            return -ERESTARTSYS;
+        }
+        mutex_lock(&slot->lock);
+    }
 
-        printk(KERN_INFO "debug: recovered bits - ");
-        for (i = 0; i < 32; i++) {
-            printk(KERN_CONT " %02x", recovered_bits[i]);
+    if (slot->state != PUF_WAITING_FOR_READ || slot->windows_read == slot->windows_count) {
+        goto out;
+    }
+
+    windows = slot->windows;
+    capacity = min(capacity, slot->windows_count - slot->windows_read);
+    responses = (struct puf_response *) kmalloc_array(capacity, sizeof(struct puf_response), GFP_KERNEL);
+    if (!responses) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    for (i = 0; i < slot->windows_count && ready < capacity; i++) {
+        if (windows[i].read || !READ_ONCE(windows[i].ready)) {
+            continue;
         }
-        printk(KERN_CONT "\n");
 
-        // TODO: handle error correctly.
-        if (decode_rs8(rs_ctrl, recovered_bits, parity_array, 32, NULL, 0, NULL, 0, NULL) < 0) {
-            printk(KERN_ERR "failed to apply ECC\n");
+        if (windows[i].cached) {
+            responses[ready].response = windows[i].response;
+        } else if (puf_read_window(slot, &windows[i], &responses[ready].response) != 0) {
+            ret = -EFAULT;
+            goto out;
         }
 
-        // debug print
-        printk(KERN_INFO "bits after ECC: ");
-        for (i = 0; i < 32; i++) {
-            printk(KERN_CONT " %02x", recovered_bits[i]);
+        responses[ready].index = i;
+        windows[i].read = true;
+        slot->windows_read++;
+        ready++;
+    }
+
+    if (slot->windows_read == slot->windows_count) {
+        record_unlock(slot);
+    }
+
+    if (copy_to_user(buf, responses, ready * sizeof(struct puf_response)) != 0) {
+        printk(KERN_ERR "failed to give response back to user\n");
+        ret = -EFAULT;
+        goto out;
+    }
+
+    ret = ready * sizeof(struct puf_response);
+
+out:
+    kfree(responses);
+    mutex_unlock(&slot->lock);
+    return ret;
+}
+
+static __poll_t puf_poll(struct file *file, poll_table *wait) {
+    __poll_t         mask = 0;
+    struct puf_slot* slot = file->private_data;
+
+    if (!slot) {
+        return 0;
+    }
+
+    poll_wait(file, &slot->wait, wait);
+
+    mutex_lock(&slot->lock);
+    if (slot->state == PUF_WAITING_FOR_READ && window_pending(slot)) {
+        mask |= EPOLLIN | EPOLLRDNORM;
+    }
+    mutex_unlock(&slot->lock);
+
+    return mask;
+}
+
+// Publishes the responses of the elapsed windows to the response page,
+// called with the slot locked.
+void publish_windows(struct puf_slot *slot) {
+    uint32_t                  i;
+    uint32_t                  response;
+    struct puf_window*        window;
+    struct puf_response_page* page = slot->page;
+
+    if (!page || slot->state != PUF_WAITING_FOR_READ || slot->windows_read == slot->windows_count) {
+        return;
+    }
+
+    for (i = 0; i < slot->windows_count; i++) {
+        window = &slot->windows[i];
+        if (window->read || !READ_ONCE(window->ready)) {
+            continue;
         }
-        printk(KERN_CONT "\n");
 
-        for (i = 0; i < 32; i++) {
-            if (recovered_bits[i] != 0x0) {
-                response |= (1 << (31 - i));
-            }
+        if (window->cached) {
+            response = window->response;
+        } else if (puf_read_window(slot, window, &response) != 0) {
+            continue;
         }
 
-	printk(KERN_INFO "debug: reconstructed response - %u(hex: 0x%08x)\n", response, response);
+        // the window is decoded before the page is marked as being written,
+        // readers retry only for the duration of the stores.
+        page_write_begin(page);
+        WRITE_ONCE(page->windows[i].response, response);
+        WRITE_ONCE(page->windows[i].ready, 1);
+        page_write_end(page);
+
+        window->read = true;
+        slot->windows_read++;
+    }
+
+    if (slot->windows_read == slot->windows_count) {
+        record_unlock(slot);
+    }
+}
+
+void publish_work(struct work_struct *work) {
+    struct puf_slot *slot = container_of(work, struct puf_slot, publish_work);
+
+    mutex_lock(&slot->lock);
+    publish_windows(slot);
+    mutex_unlock(&slot->lock);
+}
+
+// Maps the read-only response page of the session, see puf_ioctl.h.
+// Only possible once enrolled, the page is allocated on the first mapping.
+static int puf_mmap(struct file *file, struct vm_area_struct *vma) {
+    struct puf_slot*          slot = file->private_data;
+    struct puf_response_page* page = 0x0;
+    error                     err  = 0;
+
+    BUILD_BUG_ON(PUF_PAGE_SIZE > PAGE_SIZE);
+
+    if (!slot) {
+        return -EINVAL;
+    }
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE) {
+        return -EINVAL;
+    }
+    if (vma->vm_flags & VM_WRITE) {
+        return -EPERM;
+    }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+    mutex_lock(&slot->lock);
+    if (slot->windows_count > PUF_PAGE_MAX_WINDOWS) {
+        printk(KERN_ERR "slot %u: %u windows do not fit the response page\n", slot->index, slot->windows_count);
+        err = -E2BIG;
+        goto out;
+    }
 
-        if (copy_to_user(buf, &response, count) != 0) {
-            printk(KERN_ERR "failed to give response back to user\n");
-            kfree(parity_array);
-            free_rs(rs_ctrl);
-            return -EFAULT;
+    if (!slot->page) {
+        page = (struct puf_response_page *) get_zeroed_page(GFP_KERNEL);
+        if (!page) {
+            err = -ENOMEM;
+            goto out;
         }
+        page->count = slot->windows_count;
+        WRITE_ONCE(slot->page, page);
+    }
+
+    err = vm_insert_page(vma, vma->vm_start, virt_to_page(slot->page));
+    if (err) {
+        goto out;
+    }
+
+    // windows that elapsed before the page was mapped.
+    publish_windows(slot);
+
+out:
+    mutex_unlock(&slot->lock);
+    return err;
+}
+
+// Binds the session to the slot of the enrollment and starts its decay.
+int enroll(struct file *file, uint8_t *data, uint32_t count) {
+    struct puf_window* windows       = 0x0;
+    uint32_t           windows_count = 0x0;
+    struct puf_slot*   slot          = 0x0;
+    uint32_t           i             = 0x0;
+    error              err           = 0;
+
+    err = parse_enrollment(data, count, &windows, &windows_count);
+    if (err) {
+        printk(KERN_ERR "malformed enrollment data\n");
+        kfree(windows);
+        return err;
+    }
+
+    slot = find_slot(windows, windows_count);
+    if (!slot) {
+        printk(KERN_ERR "enrollment cells span more than a single slot\n");
+        free_windows(windows, windows_count);
+        return -EINVAL;
+    }
+
+    mutex_lock(&slots_lock);
+    if (slot->pid != 0) {
+        mutex_unlock(&slots_lock);
+        printk(KERN_ERR "%d trying to enroll PUF slot %u already beloning to %d\n",
+               current->pid, slot->index, slot->pid);
+        free_windows(windows, windows_count);
+        return -EBUSY;
+    }
+    slot->pid = current->pid;
+    mutex_unlock(&slots_lock);
+
+    err = init_rs_controls(windows, windows_count);
+    if (err) {
+        printk(KERN_ERR "failed to init reed solomon codecs\n");
+    }
 
-	kfree(parity_array);
-        free_rs(rs_ctrl);
+    mutex_lock(&slot->lock);
+    slot->enrolled_at = ktime_get();
+    slot->predecayed = false;
+
+    // a pre-decay cycle of the same enrollment is adopted with its windows
+    // partially (or fully) decayed, a cycle of another one is dropped.
+    if (slot->predecaying) {
+        slot->predecaying = false;
+        if (!err && count == slot->predecay_len && memcmp(data, slot->predecay_data, count) == 0) {
+            printk(KERN_INFO "PID %d adopts the pre-decay of PUF slot %u\n", current->pid, slot->index);
+            free_windows(windows, windows_count);
+            slot->predecayed = true;
+            mutex_unlock(&slot->lock);
+            file->private_data = slot;
+            return 0;
+        }
+        clear_slot(slot);
+    }
 
-	return count;
+    for (i = 0; i < windows_count; i++) {
+        windows[i].slot = slot;
+    }
+    slot->windows = windows;
+    slot->windows_count = windows_count;
+    if (!err) {
+        err = start(slot);
+    }
+    if (err) {
+        release_slot(slot);
+        mutex_unlock(&slot->lock);
+        return err;
     }
+    for (i = 0; i < windows_count; i++) {
+        slot->predecayed |= windows[i].cached;
+    }
+    mutex_unlock(&slot->lock);
 
+    printk(KERN_INFO "PID %d enrolled PUF slot %u\n", slot->pid, slot->index);
+    file->private_data = slot;
     return 0;
 }
 
 static ssize_t puf_write(struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
     size_t i = 0;
     uint8_t* data = 0;
+    error err = 0;
+    struct puf_slot* slot = file->private_data;
 
-    data = (uint8_t *) kzalloc(count, GFP_KERNEL);
-    if (!data) {
-        printk(KERN_ERR "Failed to alloc buffer for user provided data\n");
-        return -ENOMEM;
-    }
-
-    if (copy_from_user(data, buf, count)) {
+    data = (uint8_t *) memdup_user(buf, count);
+    if (IS_ERR(data)) {
         printk(KERN_ERR "Failed to copy provided data from user space into kernel space\n");
-        kfree(data);
-        return -EFAULT;
+        return PTR_ERR(data);
     }
 
     printk(KERN_INFO "recieved byte count: %d\n", count);
-    printk(KERN_INFO "Data written to device:\n");
-    printk(KERN_INFO "");
-    for (i = 0; i < count; i++) {
-        printk(KERN_CONT " %02x", data[i]);
-    }
-    printk(KERN_CONT "\n");
-
-    // Enrollment consists of multiple decay timeouts
-    // of the following format
-    // |(8bit)parity-bit-count|(16bit)16 integers|(32bit) 32 integers
-    // Example:
-    // 3|3-(16bits)integers|32-(32bits) integers
-    // 3|3-(16bits)integers|32-(32bits) integers
-    // ...
-    if (puf_state == PUF_WAITING_FOR_ENROLLMENT) {
-        printk(KERN_INFO "received enrollment data\n");
-        enrollment_data = (uint8_t *) kzalloc(count, GFP_KERNEL); 
-        if (!enrollment_data) {
-            printk(KERN_ERR "Failed to alloc buffer for user provided data\n");
-            return -ENOMEM;
+    if (debug) {
+        printk(KERN_INFO "Data written to device:\n");
+        printk(KERN_INFO "");
+        for (i = 0; i < count; i++) {
+            printk(KERN_CONT " %02x", data[i]);
         }
-        memcpy(enrollment_data, data, count);
-        start();
+        printk(KERN_CONT "\n");
     }
-    // any write after enrollments resets the PUF.
+
+    if (!slot) {
+        printk(KERN_INFO "received enrollment data\n");
+        err = enroll(file, data, count);
+    }
+    // any write after enrollments resets the slot and restarts all its windows.
     else {
-        printk(KERN_INFO "debug: reseting PUF\n");
-        memset(puf_addr, 0, puf_size);
+        puf_dbg("debug: reseting PUF slot %u\n", slot->index);
+        mutex_lock(&slot->lock);
+        err = start(slot);
+        mutex_unlock(&slot->lock);
     }
 
     kfree(data);
-    return count;
+    return err ? err : count;
+}
+
+// Pre-decay of registered enrollments, see predecay.c.
+long predecay_register(const struct puf_predecay_enrollment __user *arg);
+void predecay_clear(void);
+
+static long puf_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    switch (cmd) {
+    case PUF_IOC_FLUSH_CACHE:
+        // forces every user back to a cold unlock.
+        if (!capable(CAP_SYS_ADMIN)) {
+            return -EPERM;
+        }
+        cache_flush();
+        return 0;
+    case PUF_IOC_PREDECAY_REGISTER:
+        return predecay_register((const struct puf_predecay_enrollment __user *) arg);
+    case PUF_IOC_PREDECAY_CLEAR:
+        // aborts running cycles of every slot, as privileged as registering them.
+        if (!capable(CAP_SYS_ADMIN)) {
+            return -EPERM;
+        }
+        predecay_clear();
+        return 0;
+    default:
+        return -ENOTTY;
+    }
 }
 
 static const struct file_operations puf_fops = {
-    .owner   = THIS_MODULE,
-    .open    = puf_open,
-    .read    = puf_read,
-    .write   = puf_write,
-    .release = puf_release,
+    .owner          = THIS_MODULE,
+    .open           = puf_open,
+    .read           = puf_read,
+    .write          = puf_write,
+    .poll           = puf_poll,
+    .mmap           = puf_mmap,
+    .unlocked_ioctl = puf_ioctl,
+    .release        = puf_release,
+};
+
+// "<count> <average ms> <max ms>" of the sessions unlocked.
+static ssize_t show_unlock(char *buf, struct unlock_stats *stats) {
+    ssize_t len;
+
+    mutex_lock(&unlock_lock);
+    len = sysfs_emit(buf, "%u %llu %llu\n", stats->count,
+                     stats->count ? stats->total_ms / stats->count : 0, stats->max_ms);
+    mutex_unlock(&unlock_lock);
+
+    return len;
+}
+
+static ssize_t unlock_cold_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return show_unlock(buf, &unlock_cold);
+}
+
+static ssize_t unlock_predecayed_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return show_unlock(buf, &unlock_predecay);
+}
+
+static DEVICE_ATTR_RO(unlock_cold);
+static DEVICE_ATTR_RO(unlock_predecayed);
+
+static struct attribute *puf_attrs[] = {
+    &dev_attr_cache_hits.attr,
+    &dev_attr_cache_misses.attr,
+    &dev_attr_cache_entries.attr,
+    &dev_attr_unlock_cold.attr,
+    &dev_attr_unlock_predecayed.attr,
+    &dev_attr_warmup_cycles.attr,
+    &dev_attr_warmup_stable.attr,
+    &dev_attr_ready.attr,
+    NULL,
 };
+ATTRIBUTE_GROUPS(puf);
 
 static struct miscdevice puf_device = {
-    .minor = MISC_DYNAMIC_MINOR,
-    .name  = DEVICE_NAME,
-    .fops  = &puf_fops,
+    .minor  = MISC_DYNAMIC_MINOR,
+    .name   = DEVICE_NAME,
+    .fops   = &puf_fops,
+    .groups = puf_groups,
 };
@@ -7,44 +7,52 @@
 #include <linux/gfp.h>
 #include <linux/dma-mapping.h>
 #include <linux/miscdevice.h>
-
-#define CNTRL_MOD_REG               0x44E10000                // Control Module registers offset.
-#define BANDGAP_CTRL                CNTRL_MOD_REG + 0x0448    // Bandgap control register for reading temperature.
-#define BANDGAP_CTRL_DTEMP_OFF      8                         // Offset for temperature reading.
-#define BANDGAP_CTRL_DTEMP_MASK     0x0000FF00                // Bits used for temperature.
-#define BANDGAP_CTRL_TMPOFF         BIT(5)
-#define BANDGAP_CTRL_SOC            BIT(4)                    
-#define BANDGAP_CTRL_CLRZ           BIT(3)
-#define BANDGAP_CTRL_CONTCONV       BIT(2)
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/sort.h>
+#include <linux/jhash.h>
+#include <linux/hashtable.h>
+#include <linux/device.h>
+#include <linux/mm.h>
+#include <linux/version.h>
+
+// Register windows and software refresh shared with the plain_puf module,
+// the portable code goes through the backend (backend.h).
+#include "backend.h"
+#include "hw_regs.h"
+#include "refresh.h"
+#include "retention.h"
+#include "warm_up.h"
+#include "puf_ioctl.h"
 
 #define TEMP_POLL_PERIOD        2                             // Number of seconds between individual temperature reads.
 
-#define EMIF0_REG               0x4C000000                    // EMIF0 register base.
-#define SDRAM_REF_CTRL          EMIF0_REG + 0x10              // Offset for the register of the SDRAM REFRESH CONTROL register.
-#define SDRAM_REF_CTRL_SDHW     EMIF0_REG + 0x14              // Offset for shadow register of the SDRAM REFRESH CONTROL register.
-
 #define DDR_END                 0x9fdfffff                    // SDRAM end for CPU.
 #define DDR_BASE                0x80000000                    // SDRAM base for CPU.
 
 #define REFRESH_PERIOD          55                            // Refresh period for custom SDRAM refresh.
-#define DISABLE_REFRESH         BIT(31)                       // Bit to flip to disable/enable SDRAM refresh.
 
 #define ROW_SIZE                2 * (1<<10)                   // bus_width * page_size.
 #define DEVICE_NAME             "puf"
 
-#define PUF_WARM_UP_PERIOD      150			      // Number of seconds the cells will be in decay.
-#define PUF_WARM_UP_RETRY       4			      // how many times this will be repeated.
+#define PUF_MAX_SLOTS           16                            // Upper bound of puf_slots.
+
+#define PUF_WARM_UP_PERIOD      150			      // Default number of seconds the cells will be in decay.
+#define PUF_WARM_UP_RETRY       4			      // Default upper bound of how many times this will be repeated.
 
 // PUF is in warm up stage
 #define PUF_WARM_UP  0x0
-// PUF is in unused state.
+// PUF (slot) is in unused state.
 // It completed all the decay requests from a program
 // and waits for another program.
 #define PUF_UNUSED   0x1
 // PUF was registerd with a certain PID, but
 // is waiting for the enrollment data before starting.
 #define PUF_WAITING_FOR_ENROLLMENT 0x2
-// PUF was successfully generated and is waiting
+// PUF slot was successfully generated and is waiting
 // to be read by the process.
 #define PUF_WAITING_FOR_READ       0x3
 
@@ -52,39 +60,58 @@ typedef unsigned char uint8_t;
 typedef unsigned int uint32_t;
 typedef int error;
 
+// Verbose logging of the read, write and refresh paths. Off by default as
+// console output under the workqueues distorts the decay timing.
+static bool debug = false;
+module_param(debug, bool, 0644);
+MODULE_PARM_DESC(debug, "log every cell read, enrollment byte and refresh register access");
+
+#define puf_dbg(fmt, ...) do { if (debug) printk(KERN_INFO fmt, ##__VA_ARGS__); } while (0)
+
+#define CREATE_TRACE_POINTS
+#include "puf_trace.h"
+
 uint8_t puf_state  	    = PUF_WARM_UP;
-uint8_t puf_warm_up_retries = PUF_WARM_UP_RETRY;
 bool user_supplied_address  = false;
 
-static struct delayed_work work_warm_up;
-
 /////////////////////////////////////
 //        Reed Solomon ECC   .     //
 ////////////////////////////////////
 #define CONFIG_REED_SOLOMON_ENC8
 #define CONFIG_REED_SOLOMON_DEC8
+#define CONFIG_REED_SOLOMON_SPLIT8
 #include "ecc/reed_solomon.c"
 
 /////////////////////////////////////
-//        Communication utils.     //
+//  Enrollment format, read path.  //
 ////////////////////////////////////
-#include "protocol.c"
+#include "puf_core.h"
 
 /////////////////////////////////////
-//          BBB memory access.     //
+//          PUF related code.      //
 ////////////////////////////////////
-#include "memory.c"
+#include "puf_ops.c"
 
 /////////////////////////////////////
-//          PUF related code.      //
+//          Response cache.        //
 ////////////////////////////////////
-#include "puf_ops.c"
+#include "cache.c"
+
+/////////////////////////////////////
+//             Warm up.            //
+////////////////////////////////////
+#include "warm_up.c"
 
 /////////////////////////////////////
 //          Register Device.       //
 ////////////////////////////////////
 #include "device.c"
 
+/////////////////////////////////////
+//            Pre-decay.           //
+////////////////////////////////////
+#include "predecay.c"
+
 void deinit_puf_buffer(void) {
     if (puf_addr) {
         printk(KERN_INFO "Freeing %zu bytes of physically contiguous memory\n", puf_size);
@@ -112,35 +139,35 @@ int init_puf_buffer(void) {
     return 0;
 }
 
-void warm_up(struct work_struct *work) {
-    struct delayed_work *dwork;
-    
-    dwork = to_delayed_work(work);
-    puf_warm_up_retries -= 1;
-    if (puf_warm_up_retries == 0) {
-        printk(KERN_INFO "PUF warm up completed, can now be used\n");
-	end_puf();
-	puf_state = PUF_UNUSED;
-	return;
-    }
-
-    printk(KERN_INFO "debug: reseting PUF, left: %d\n", puf_warm_up_retries);
-    memset(puf_addr, 0, puf_size);
-    schedule_delayed_work(dwork, msecs_to_jiffies(PUF_WARM_UP_PERIOD * 1000));
-}
-
 static int __init puf_start(void) {
     error err;
 
-    INIT_DELAYED_WORK(&work_sdram, sdram_refresh);
     INIT_DELAYED_WORK(&work_temp_poll, temp_polling);
-    INIT_DELAYED_WORK(&work_warm_up, warm_up);
 
     if (puf_size == 0) {
         printk(KERN_ERR "puf_size needs to be non-empty\n");
         return -ENOMEM;
     }
 
+    // every slot spans whole rows.
+    if (puf_slots == 0 || puf_slots > PUF_MAX_SLOTS || puf_size % (puf_slots * ROW_SIZE) != 0) {
+        printk(KERN_ERR "puf_slots needs to be within 1..%d and split puf_size into whole rows\n", PUF_MAX_SLOTS);
+        return -EINVAL;
+    }
+    init_slots();
+    init_predecay();
+
+    err = init_warm_up();
+    if (err) {
+        return err;
+    }
+
+    err = hw_regs_map();
+    if (err) {
+        printk(KERN_ERR "failed to map the EMIF0 and control module registers\n");
+        return err;
+    }
+
     // if the phys address is not allocated by the user
     // allocate a buffer.
     if (puf_phys_addr == 0x0) {
@@ -150,6 +177,7 @@ static int __init puf_start(void) {
         puf_addr = phys_to_virt(puf_phys_addr);
         if (!puf_addr) {
             printk(KERN_ERR "failed to translate physical address to virtual\n");
+            hw_regs_unmap();
             return -EFAULT;
         }
     }
@@ -159,31 +187,48 @@ static int __init puf_start(void) {
     printk(KERN_INFO "PUF virtual address: %lx\n", (long unsigned int) puf_addr);
     printk(KERN_INFO "PUF physical address: %llx\n", (unsigned long long) puf_phys_addr);
 
+    // the software refresh skips the PUF region.
+    err = init_sdram_refresh();
+    if (!err) {
+        err = get_puf();
+    }
+    if (err) {
+        if (!user_supplied_address) {
+            deinit_puf_buffer();
+        }
+        hw_regs_unmap();
+        return err;
+    }
+
     // create device.
     err = misc_register(&puf_device);
     if (err) {
         pr_err("Failed to register puf device\n");
-        deinit_puf_buffer();
+        put_puf();
+        if (!user_supplied_address) {
+            deinit_puf_buffer();
+        }
+        hw_regs_unmap();
         return err;
     }
 
     // capture temparature
     start_temp_polling();
     // start warm up
-    printk(KERN_INFO "Starting PUF warmup");
-    schedule_delayed_work(&work_warm_up, msecs_to_jiffies(PUF_WARM_UP_PERIOD * 1000));
-    start_puf();
+    start_warm_up();
     return 0;
 }
 
 static void __exit puf_end(void) {
-    cancel_delayed_work_sync(&work_warm_up);
+    stop_warm_up();
     stop_temp_polling();
+    predecay_clear();
     device_cleanup();
     misc_deregister(&puf_device);
     if (!user_supplied_address) {
         deinit_puf_buffer();
     }
+    hw_regs_unmap();
 }
 
 module_init(puf_start);
@@ -58,6 +58,68 @@
 
 	/* form the syndromes; i.e., evaluate data(x) at roots of
 	 * g(x) */
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+	if (rs->mm == 8) {
+		uint8_t *split = rs_split_syn(rsc);
+		uint8_t *t0, *t1, *t2, *t3;
+		uint16_t s0, s1, s2, s3;
+
+		/*
+		 * Horner's rule, syn[i] = syn[i] * root[i] + symbol, four
+		 * roots at a time to overlap their dependency chains, the
+		 * data and the parity in loops of their own.
+		 */
+		for (i = 0; i + 4 <= nroots; i += 4) {
+			t0 = split + 32 * i;
+			t1 = t0 + 32;
+			t2 = t1 + 32;
+			t3 = t2 + 32;
+			s0 = s1 = s2 = s3 = (((uint16_t) data[0]) ^ invmsk) & msk;
+			for (j = 1; j < len; j++) {
+				u = (((uint16_t) data[j]) ^ invmsk) & msk;
+				s0 = u ^ RS_SPLIT_MUL(t0, s0);
+				s1 = u ^ RS_SPLIT_MUL(t1, s1);
+				s2 = u ^ RS_SPLIT_MUL(t2, s2);
+				s3 = u ^ RS_SPLIT_MUL(t3, s3);
+			}
+			for (j = 0; j < nroots; j++) {
+				u = ((uint16_t) par[j]) & msk;
+				s0 = u ^ RS_SPLIT_MUL(t0, s0);
+				s1 = u ^ RS_SPLIT_MUL(t1, s1);
+				s2 = u ^ RS_SPLIT_MUL(t2, s2);
+				s3 = u ^ RS_SPLIT_MUL(t3, s3);
+			}
+			syn[i] = s0;
+			syn[i + 1] = s1;
+			syn[i + 2] = s2;
+			syn[i + 3] = s3;
+		}
+
+		/*
+		 * The remaining roots two at a time, the last one repeated
+		 * if nroots is odd.
+		 */
+		for (; i < nroots; i += 2) {
+			t0 = split + 32 * i;
+			t1 = split + 32 * min(i + 1, nroots - 1);
+			s0 = s1 = (((uint16_t) data[0]) ^ invmsk) & msk;
+			for (j = 1; j < len; j++) {
+				u = (((uint16_t) data[j]) ^ invmsk) & msk;
+				s0 = u ^ RS_SPLIT_MUL(t0, s0);
+				s1 = u ^ RS_SPLIT_MUL(t1, s1);
+			}
+			for (j = 0; j < nroots; j++) {
+				u = ((uint16_t) par[j]) & msk;
+				s0 = u ^ RS_SPLIT_MUL(t0, s0);
+				s1 = u ^ RS_SPLIT_MUL(t1, s1);
+			}
+			syn[i] = s0;
+			if (i + 1 < nroots)
+				syn[i + 1] = s1;
+		}
+		goto syndromes;
+	}
+#endif
 	for (i = 0; i < nroots; i++)
 		syn[i] = (((uint16_t) data[0]) ^ invmsk) & msk;
 
@@ -86,6 +148,9 @@
 			}
 		}
 	}
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+ syndromes:
+#endif
 	s = syn;
 
 	/* Convert syndromes to index form, checking for nonzero condition */
@@ -197,7 +262,24 @@
 	/* Find roots of error+erasure locator polynomial by Chien search */
 	memcpy(&reg[1], &lambda[1], nroots * sizeof(reg[0]));
 	count = 0;		/* Number of roots of lambda(x) */
-	for (i = 1, k = iprim - 1; i <= nn; i++, k = rs_modnn(rs, k + iprim)) {
+	i = 1;
+	k = iprim - 1;
+	/*
+	 * With prim 1 the error location of step i is i - 1, the first
+	 * pad steps of a shortened code can only find impossible
+	 * locations. Start at the first possible one instead, a root
+	 * skipped this way leaves count below deg_lambda and is
+	 * reported as uncorrectable all the same.
+	 */
+	if (prim == 1 && pad > 0) {
+		for (j = 1; j <= deg_lambda; j++) {
+			if (reg[j] != nn)
+				reg[j] = rs_modnn(rs, reg[j] + j * pad);
+		}
+		i = pad + 1;
+		k = pad;
+	}
+	for (; i <= nn; i++, k = rs_modnn(rs, k + iprim)) {
 		q = 1;		/* lambda[0] is always 0 */
 		for (j = deg_lambda; j > 0; j--) {
 			if (reg[j] != nn) {
@@ -25,6 +25,25 @@
 	if (pad < 0 || pad >= nn)
 		return -ERANGE;
 
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+	if (rs->mm == 8) {
+		uint8_t *gen = rs_split_gen(rsc);
+		uint8_t *lo, *hi;
+
+		for (i = 0; i < len; i++) {
+			/* feedback term in polynomial form */
+			fb = ((((uint16_t) data[i])^invmsk) & msk) ^ par[0];
+			lo = gen + (fb & 0xf) * nroots;
+			hi = gen + (16 + (fb >> 4)) * nroots;
+			/* Shift and add the feedback times genpoly[] */
+			for (j = 0; j < nroots - 1; j++)
+				par[j] = par[j + 1] ^ lo[j] ^ hi[j];
+			par[nroots - 1] = lo[nroots - 1] ^ hi[nroots - 1];
+		}
+		return 0;
+	}
+#endif
+
 	for (i = 0; i < len; i++) {
 		fb = index_of[((((uint16_t) data[i])^invmsk) & msk) ^ par[0]];
 		/* feedback term is non-zero */
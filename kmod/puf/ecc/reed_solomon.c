@@ -29,6 +29,7 @@
  * provide a syndrome calculation over the received data + syndrome and can
  * call the second stage directly.
  */
+#ifdef __KERNEL__
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
@@ -36,6 +37,9 @@
 #include <linux/rslib.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
+#else
+#include "rslib.h"
+#endif
 
 enum {
 	RS_DECODE_LAMBDA,
@@ -54,6 +58,75 @@ static LIST_HEAD(codec_list);
 /* Protection for the list */
 static DEFINE_MUTEX(rslistlock);
 
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+/*
+ * Split nibble tables for 8 bit symbols. The product of a constant c and
+ * a symbol x is lo[x & 0xf] ^ hi[x >> 4], where lo and hi hold the
+ * multiples of c by the 16 low and the 16 high nibbles. Two loads and a
+ * xor replace the log / antilog lookups, the modulo reduction and the
+ * zero test of the generic loops.
+ *
+ * The tables of a control struct follow its decoder buffers:
+ * [nroots][32] multiples of the roots of the generator polynomial for
+ * the syndromes, followed by [32][nroots] multiples of the generator
+ * coefficients for the encoder. The encoder rows are indexed by the
+ * nibble, a feedback term updates all parity symbols with two rows.
+ */
+#define RS_SPLIT_SIZE(nroots)	(2 * 32 * (nroots))
+
+/* Product of the constant of table t and the symbol x */
+#define RS_SPLIT_MUL(t, x)	((t)[(x) & 0xf] ^ (t)[16 + ((x) >> 4)])
+
+static inline uint8_t *rs_split_syn(struct rs_control *rsc)
+{
+	return (uint8_t *)(rsc->buffers +
+			   RS_DECODE_NUM_BUFFERS * (rsc->codec->nroots + 1));
+}
+
+static inline uint8_t *rs_split_gen(struct rs_control *rsc)
+{
+	return rs_split_syn(rsc) + 32 * rsc->codec->nroots;
+}
+
+/* Product of a and b, both in polynomial form */
+static uint8_t rs_split_mul(struct rs_codec *rs, int a, int b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	return rs->alpha_to[rs_modnn(rs, rs->index_of[a] + rs->index_of[b])];
+}
+
+/**
+ * split_init - Fill the split nibble tables of a control struct
+ * @rsc:	the rs control structure, with an 8 bit symbol codec
+ */
+static void split_init(struct rs_control *rsc)
+{
+	struct rs_codec *rs = rsc->codec;
+	uint8_t *syn = rs_split_syn(rsc);
+	uint8_t *gen = rs_split_gen(rsc);
+	int nroots = rs->nroots;
+	int i, n, c;
+
+	for (i = 0; i < nroots; i++) {
+		c = rs->alpha_to[rs_modnn(rs, (rs->fcr + i) * rs->prim)];
+		for (n = 0; n < 16; n++) {
+			syn[32 * i + n] = rs_split_mul(rs, c, n);
+			syn[32 * i + 16 + n] = rs_split_mul(rs, c, n << 4);
+		}
+	}
+
+	/* genpoly[] is in index form, row i holds genpoly[nroots - 1 - i] */
+	for (i = 0; i < nroots; i++) {
+		c = rs->alpha_to[rs->genpoly[nroots - 1 - i]];
+		for (n = 0; n < 16; n++) {
+			gen[n * nroots + i] = rs_split_mul(rs, c, n);
+			gen[(16 + n) * nroots + i] = rs_split_mul(rs, c, n << 4);
+		}
+	}
+}
+#endif
+
 /**
  * codec_init - Initialize a Reed-Solomon codec
  * @symsize:	symbol size, bits (1-8)
@@ -234,6 +307,10 @@ static struct rs_control *init_rs_internal(int symsize, int gfpoly,
 	 * stack. Size the buffers to arrays of [nroots + 1].
 	 */
 	bsize = sizeof(uint16_t) * RS_DECODE_NUM_BUFFERS * (nroots + 1);
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+	if (symsize == 8)
+		bsize += RS_SPLIT_SIZE(nroots);
+#endif
 	rs = kzalloc(sizeof(*rs) + bsize, gfp);
 	if (!rs)
 		return NULL;
@@ -269,6 +346,10 @@ static struct rs_control *init_rs_internal(int symsize, int gfpoly,
 		rs = NULL;
 	}
 out:
+#ifdef CONFIG_REED_SOLOMON_SPLIT8
+	if (rs && symsize == 8)
+		split_init(rs);
+#endif
 	mutex_unlock(&rslistlock);
 	return rs;
 }
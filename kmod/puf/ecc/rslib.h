@@ -10,8 +10,12 @@
 #ifndef _RSLIB_H_
 #define _RSLIB_H_
 
+#ifdef __KERNEL__
 #include <linux/types.h>	/* for gfp_t */
 #include <linux/gfp.h>		/* for GFP_KERNEL */
+#else
+#include "backend.h"		/* userspace gfp_t, list_head */
+#endif
 
 /**
  * struct rs_codec - rs codec data
@@ -0,0 +1,183 @@
+// Pre-decay of enrollments registered ahead of time (PUF_IOC_PREDECAY_REGISTER).
+//
+// Whenever the slot of a registered enrollment is free, the enrollment is decayed in the
+// background and its responses are decoded into the response cache, so that the process
+// presenting it later is served right away. A process enrolling the same enrollment while a
+// cycle runs adopts the cycle with its windows already partially decayed, a process enrolling
+// a different one preempts it.
+
+#define PUF_PREDECAY_POLL_MS    10                            // Re-check of a cycle whose windows are not all ready yet.
+
+static uint32_t predecay_period_ms = 60000;
+module_param(predecay_period_ms, uint, 0644);
+MODULE_PARM_DESC(predecay_period_ms, "milliseconds between the starts of two pre-decay cycles, should stay below cache_ttl_ms (default 60000)");
+
+void predecay_schedule(struct puf_slot *slot, uint32_t ms) {
+    mod_delayed_work(system_wq, &slot->predecay_work, msecs_to_jiffies(ms));
+}
+
+// Decodes the responses of a completed cycle into the cache, called with the slot locked.
+void predecay_collect(struct puf_slot *slot) {
+    uint32_t i;
+    uint32_t response;
+
+    for (i = 0; i < slot->windows_count; i++) {
+        if (!READ_ONCE(slot->windows[i].ready)) {
+            predecay_schedule(slot, PUF_PREDECAY_POLL_MS);
+            return;
+        }
+    }
+
+    // every window decayed (start() skips the cache for a cycle), decoding it reinserts
+    // its entry with a fresh ttl.
+    for (i = 0; i < slot->windows_count; i++) {
+        puf_read_window(slot, &slot->windows[i], &response);
+    }
+    puf_dbg("debug: pre-decay of PUF slot %u done\n", slot->index);
+
+    slot->predecaying = false;
+    clear_slot(slot);
+    predecay_schedule(slot, predecay_period_ms);
+}
+
+// Starts a cycle of the registered enrollment, called with the slot locked.
+void predecay_begin(struct puf_slot *slot) {
+    struct puf_window* windows       = 0x0;
+    uint32_t           windows_count = 0x0;
+    uint32_t           longest       = 0x0;
+    uint32_t           i             = 0x0;
+    bool               busy;
+    error              err;
+
+    // the slot belongs to a process, try again later.
+    mutex_lock(&slots_lock);
+    busy = puf_state == PUF_WARM_UP || slot->pid != 0 || slot->windows != 0x0;
+    mutex_unlock(&slots_lock);
+    if (busy) {
+        predecay_schedule(slot, predecay_period_ms);
+        return;
+    }
+
+    // validated when registered.
+    err = parse_enrollment(slot->predecay_data, slot->predecay_len, &windows, &windows_count);
+    if (!err) {
+        err = init_rs_controls(windows, windows_count);
+    }
+    if (err) {
+        printk(KERN_ERR "slot %u: failed to prepare the pre-decay\n", slot->index);
+        if (windows) {
+            free_windows(windows, windows_count);
+        }
+        predecay_schedule(slot, predecay_period_ms);
+        return;
+    }
+
+    for (i = 0; i < windows_count; i++) {
+        windows[i].slot = slot;
+        longest = max(longest, windows[i].enrolled.decay_ms);
+    }
+    slot->windows = windows;
+    slot->windows_count = windows_count;
+    slot->predecaying = true;
+
+    err = start(slot);
+    if (err) {
+        slot->predecaying = false;
+        clear_slot(slot);
+        predecay_schedule(slot, predecay_period_ms);
+        return;
+    }
+
+    puf_dbg("debug: pre-decay of PUF slot %u started\n", slot->index);
+    predecay_schedule(slot, longest + PUF_PREDECAY_POLL_MS);
+}
+
+void predecay_cycle(struct work_struct *work) {
+    struct puf_slot *slot = container_of(to_delayed_work(work), struct puf_slot, predecay_work);
+
+    mutex_lock(&slot->lock);
+    if (slot->predecay_data) {
+        if (slot->predecaying) {
+            predecay_collect(slot);
+        } else {
+            predecay_begin(slot);
+        }
+    }
+    mutex_unlock(&slot->lock);
+}
+
+void init_predecay(void) {
+    uint32_t i;
+
+    for (i = 0; i < puf_slots; i++) {
+        INIT_DELAYED_WORK(&slots[i].predecay_work, predecay_cycle);
+    }
+}
+
+long predecay_register(const struct puf_predecay_enrollment __user *arg) {
+    struct puf_predecay_enrollment req;
+    struct puf_window*             windows       = 0x0;
+    uint32_t                       windows_count = 0x0;
+    struct puf_slot*               slot          = 0x0;
+    uint8_t*                       data          = 0x0;
+    error                          err           = 0;
+
+    if (!capable(CAP_SYS_ADMIN)) {
+        return -EPERM;
+    }
+    // the pre-decayed responses are handed to the process via the cache.
+    if (cache_ttl_ms == 0) {
+        printk(KERN_ERR "pre-decay needs the response cache, set cache_ttl_ms\n");
+        return -EINVAL;
+    }
+    if (copy_from_user(&req, arg, sizeof(req)) != 0) {
+        return -EFAULT;
+    }
+
+    data = (uint8_t *) memdup_user(u64_to_user_ptr(req.data), req.len);
+    if (IS_ERR(data)) {
+        return PTR_ERR(data);
+    }
+
+    err = parse_enrollment(data, req.len, &windows, &windows_count);
+    if (err) {
+        printk(KERN_ERR "malformed pre-decay enrollment\n");
+        kfree(data);
+        return err;
+    }
+    slot = find_slot(windows, windows_count);
+    free_windows(windows, windows_count);
+    if (!slot) {
+        printk(KERN_ERR "pre-decay enrollment cells span more than a single slot\n");
+        kfree(data);
+        return -EINVAL;
+    }
+
+    mutex_lock(&slot->lock);
+    kfree(slot->predecay_data);
+    slot->predecay_data = data;
+    slot->predecay_len = req.len;
+    mutex_unlock(&slot->lock);
+
+    printk(KERN_INFO "registered pre-decay of PUF slot %u\n", slot->index);
+    predecay_schedule(slot, 0);
+    return 0;
+}
+
+void predecay_clear(void) {
+    uint32_t i;
+
+    for (i = 0; i < puf_slots; i++) {
+        cancel_delayed_work_sync(&slots[i].predecay_work);
+
+        mutex_lock(&slots[i].lock);
+        if (slots[i].predecaying) {
+            slots[i].predecaying = false;
+            clear_slot(&slots[i]);
+        }
+        kfree(slots[i].predecay_data);
+        slots[i].predecay_data = 0x0;
+        slots[i].predecay_len = 0x0;
+        mutex_unlock(&slots[i].lock);
+    }
+}
@@ -0,0 +1,282 @@
+#ifndef PUF_CORE_H
+#define PUF_CORE_H
+
+// Portable core of the puf module: the enrollment format, the read path of a
+// decay window and the slot an enrollment is bound to. Written against the backend (backend.h) only, so that the same
+// code runs in the module and in userspace (see kmod/bench).
+//
+// Expects the Reed Solomon codec (ecc/reed_solomon.c, with CONFIG_REED_SOLOMON_DEC8)
+// to be included before it, like the module does.
+
+#include "backend.h"
+
+#define PUF_MAX_PARITY          32                            // At most one parity symbol per response bit.
+#define PUF_ENROLLMENT_VERSION  1                             // Version of the enrollment set format.
+#define PUF_ENROLLMENT_VERSION_TEMP 2                         // Version of the sets carrying their reference temperature.
+#define PUF_SET_HEADER_SIZE     4                             // |version|flags|(16bit)record count| of each set.
+#define PUF_SET_TEMP_SIZE       2                             // |(8bit)reference temperature|(8bit)halving| following version 2 headers.
+#define PUF_SET_FLAG_PACKED     0x1                           // Records protect the 4 response bytes, with 8bit parity symbols.
+#define PUF_SET_FLAGS           PUF_SET_FLAG_PACKED           // Flags understood by the module.
+
+// A cell of the PUF region holding one response bit.
+struct puf_cell {
+    uint32_t block; // 16bit block of the PUF region.
+    uint8_t  mask;  // bit within the block.
+    uint8_t  bit;   // position of the bit in the response.
+};
+
+// Header of an enrollment set, shared by its records.
+struct puf_set {
+    uint8_t  version;
+    uint8_t  flags;
+    uint16_t records;
+    int16_t  reference_temp;                // DTEMP code the records were enrolled at, -1 if unknown.
+    uint8_t  halving;                       // DTEMP codes halving the retention, 0 if unknown.
+};
+
+// An enrollment record, the enrolled part of a decay window.
+struct puf_record {
+    uint32_t        decay_ms;               // milliseconds after the start of the decay the cells can be read.
+    int16_t         reference_temp;         // DTEMP code the window was enrolled at, -1 if unknown.
+    uint8_t         halving;                // DTEMP codes halving the retention, 0 uses retention_halving.
+    bool            packed;                 // the parity protects the 4 response bytes instead of the 32 bits.
+    uint8_t         parity_len;             // number of parity symbols.
+    uint16_t        parity[PUF_MAX_PARITY]; // parity symbols of the 32 response bits, or of the 4 bytes if packed.
+    struct puf_cell cells[32];              // cells of the response bits, ordered by their block.
+};
+
+static inline uint8_t puf_consume_8bits_be(uint32_t *ptr, const uint8_t *data) {
+    return data[(*ptr)++];
+}
+
+static inline uint16_t puf_consume_16bits_be(uint32_t *ptr, const uint8_t *data) {
+    uint16_t value = (((uint16_t) data[*ptr]) << 8) | data[(*ptr) + 1];
+
+    *ptr += 2;
+    return value;
+}
+
+static inline uint32_t puf_consume_32bits_be(uint32_t *ptr, const uint8_t *data) {
+    uint32_t value = (((uint32_t) data[*ptr]) << 24)
+                   | (((uint32_t) data[(*ptr) + 1]) << 16)
+                   | (((uint32_t) data[(*ptr) + 2]) << 8)
+                   | data[(*ptr) + 3];
+
+    *ptr += 4;
+    return value;
+}
+
+// Consumes the set header at *ptr of the enrollment data of count bytes
+// |(8bit)version|(8bit)flags|(16bit)record-count|
+// version 2 headers are followed by the temperature the records were enrolled at
+// |(8bit)reference DTEMP code|(8bit)DTEMP codes halving the retention, 0 if unknown|
+// The records of sets flagged PUF_SET_FLAG_PACKED carry 8bit parity symbols.
+static inline int puf_parse_set(const uint8_t *data, uint32_t count, uint32_t *ptr, struct puf_set *set) {
+    if (count - *ptr < PUF_SET_HEADER_SIZE) {
+        return -EINVAL;
+    }
+    set->version = data[*ptr];
+    set->flags = data[*ptr + 1];
+    if ((set->version != PUF_ENROLLMENT_VERSION && set->version != PUF_ENROLLMENT_VERSION_TEMP)
+        || (set->flags & ~PUF_SET_FLAGS) != 0x0) {
+        puf_be_err("unsupported enrollment set version %d flags %d\n", data[*ptr], data[*ptr + 1]);
+        return -EINVAL;
+    }
+    *ptr += 2;
+    set->records = puf_consume_16bits_be(ptr, data);
+    if (set->records == 0) {
+        return -EINVAL;
+    }
+
+    set->reference_temp = -1;
+    set->halving = 0x0;
+    if (set->version == PUF_ENROLLMENT_VERSION_TEMP) {
+        if (count - *ptr < PUF_SET_TEMP_SIZE) {
+            return -EINVAL;
+        }
+        set->reference_temp = puf_consume_8bits_be(ptr, data);
+        set->halving = puf_consume_8bits_be(ptr, data);
+    }
+    return 0;
+}
+
+// Size of the record at ptr of the set
+// |(32bit)decay-ms|(8bit)parity-bit-count|(16bit) parity integers|(32bit) 32 integers|
+// with (8bit) parity integers in packed sets, or 0 if it is truncated or carries more
+// than PUF_MAX_PARITY parity symbols.
+static inline uint32_t puf_record_size(const uint8_t *data, uint32_t count, uint32_t ptr, const struct puf_set *set) {
+    uint32_t parity;
+    uint32_t record;
+
+    if (count - ptr < sizeof(uint32_t) + sizeof(uint8_t)) {
+        return 0;
+    }
+    parity = data[ptr + sizeof(uint32_t)];
+    if (parity > PUF_MAX_PARITY) {
+        return 0;
+    }
+    record = sizeof(uint32_t) + sizeof(uint8_t) + 32 * sizeof(uint32_t)
+           + parity * (set->flags & PUF_SET_FLAG_PACKED ? sizeof(uint8_t) : sizeof(uint16_t));
+    if (count - ptr < record) {
+        return 0;
+    }
+    return record;
+}
+
+// End of the bytes of the PUF region holding the cells of the record at ptr,
+// validated by puf_record_size. The cell pointers are the last 32 integers of it.
+static inline uint32_t puf_record_cells_end(const uint8_t *data, uint32_t ptr, uint32_t record) {
+    uint32_t j;
+    uint32_t block;
+    uint32_t end = 0x0;
+
+    ptr += record - 32 * sizeof(uint32_t);
+    for (j = 0; j < 32; j++) {
+        block = puf_consume_32bits_be(&ptr, data) >> 4;
+        if ((block + 1) * sizeof(uint16_t) > end) {
+            end = (block + 1) * sizeof(uint16_t);
+        }
+    }
+    return end;
+}
+
+static inline int puf_compare_cells(const void *lhs, const void *rhs) {
+    const struct puf_cell *l = lhs;
+    const struct puf_cell *r = rhs;
+
+    if (l->block != r->block) {
+        return l->block < r->block ? -1 : 1;
+    }
+    return l->bit - r->bit;
+}
+
+// Decodes the record at *ptr of the set, validated by puf_record_size.
+static inline void puf_decode_record(const uint8_t *data, uint32_t *ptr, const struct puf_set *set,
+                                     struct puf_record *record) {
+    uint32_t j;
+    uint32_t block_ptr;
+
+    record->reference_temp = set->reference_temp;
+    record->halving = set->halving;
+    record->packed = set->flags & PUF_SET_FLAG_PACKED;
+    record->decay_ms = puf_consume_32bits_be(ptr, data);
+    record->parity_len = puf_consume_8bits_be(ptr, data);
+    for (j = 0; j < record->parity_len; j++) {
+        record->parity[j] = record->packed ? puf_consume_8bits_be(ptr, data) : puf_consume_16bits_be(ptr, data);
+    }
+    for (j = 0; j < 32; j++) {
+        block_ptr = puf_consume_32bits_be(ptr, data);
+        record->cells[j].block = block_ptr >> 4;
+        record->cells[j].mask = block_ptr & 0xf;
+        record->cells[j].bit = j;
+    }
+    // the cells are scattered across the PUF region, reading them in
+    // address order touches each DRAM row once and each block once.
+    puf_be_sort(record->cells, 32, sizeof(struct puf_cell), puf_compare_cells);
+}
+
+// Loads the response bits of the record from the PUF region mapped at base,
+// one byte per bit as the decoder expects them. The cells are ordered by block,
+// each block is loaded once and its bits are scattered back to their position.
+static inline void puf_read_cells(const struct puf_record *record, const uint8_t *base, uint8_t bits[32]) {
+    uint32_t i;
+    uint16_t memory = 0x0;
+    const struct puf_cell *cell;
+
+    for (i = 0; i < 32; i++) {
+        cell = &record->cells[i];
+        if (i == 0 || cell->block != record->cells[i - 1].block) {
+            memory = puf_be_r16_be(base + cell->block * sizeof(uint16_t));
+        }
+        bits[cell->bit] = (memory >> cell->mask) & 0x1;
+    }
+}
+
+// Corrects the bits in place against the enrolled parity, rs has to be built
+// for record->parity_len symbols. Returns the number of corrected symbols, or
+// a negative error if the bits could not be corrected.
+//
+// Unless packed, every bit is a symbol of its own. Packed records correct the
+// response bytes, a code of 4 instead of 32 data symbols, so a symbol error
+// costs the same parity but up to 8 bit errors fall into a single symbol.
+static inline int puf_correct(struct rs_control *rs, const struct puf_record *record, uint8_t bits[32]) {
+    uint16_t parity[PUF_MAX_PARITY];
+    uint8_t  bytes[4] = {0x0};
+    uint32_t i;
+    int      corrected;
+
+    // the decoder works in place on the parity, keep the enrolled one intact.
+    memcpy(parity, record->parity, record->parity_len * sizeof(uint16_t));
+    if (!record->packed) {
+        return decode_rs8(rs, bits, parity, 32, NULL, 0, NULL, 0, NULL);
+    }
+
+    for (i = 0; i < 32; i++) {
+        bytes[i / 8] |= bits[i] << (7 - i % 8);
+    }
+    corrected = decode_rs8(rs, bytes, parity, 4, NULL, 0, NULL, 0, NULL);
+    if (corrected > 0) {
+        for (i = 0; i < 32; i++) {
+            bits[i] = (bytes[i / 8] >> (7 - i % 8)) & 0x1;
+        }
+    }
+    return corrected;
+}
+
+// Widens [*beg, *end) to the bytes of the PUF region holding the cells of the record.
+static inline void puf_record_span(const struct puf_record *record, uint32_t *beg, uint32_t *end) {
+    // the cells are ordered by their block.
+    uint32_t first = record->cells[0].block * sizeof(uint16_t);
+    uint32_t last  = record->cells[31].block * sizeof(uint16_t) + sizeof(uint16_t);
+
+    if (first < *beg) {
+        *beg = first;
+    }
+    if (last > *end) {
+        *end = last;
+    }
+}
+
+// Index of the slot holding the bytes [beg, end) of the PUF region split into count
+// slots of size bytes each, or -1 if they span more than a single slot.
+static inline int puf_find_slot(uint32_t beg, uint32_t end, uint32_t size, uint32_t count) {
+    uint32_t slot;
+
+    if (size == 0 || beg >= end) {
+        return -1;
+    }
+    slot = beg / size;
+    if (slot >= count || end > (slot + 1) * size) {
+        return -1;
+    }
+    return slot;
+}
+
+// Bytes [*offset, *offset + *size) of slot index of the PUF region of puf_size
+// bytes split into count equally sized slots.
+static inline void puf_slot_range(uint32_t puf_size, uint32_t count, uint32_t index, uint32_t *offset,
+                                  uint32_t *size) {
+    *size = puf_size / count;
+    *offset = index * *size;
+}
+
+// Clears the cells of a slot of the PUF region mapped at base before it decays,
+// the cells of the other slots, possibly decaying, are left alone.
+static inline void puf_clear_slot(uint8_t *base, uint32_t offset, uint32_t size) {
+    memset(base + offset, 0, size);
+}
+
+// Packs the response bits, the first bit being the most significant one.
+static inline uint32_t puf_bits_to_response(const uint8_t bits[32]) {
+    uint32_t i;
+    uint32_t response = 0x0;
+
+    for (i = 0; i < 32; i++) {
+        if (bits[i] != 0x0) {
+            response |= (1u << (31 - i));
+        }
+    }
+    return response;
+}
+
+#endif // PUF_CORE_H
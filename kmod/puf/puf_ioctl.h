@@ -0,0 +1,58 @@
+#ifndef PUF_IOCTL_H
+#define PUF_IOCTL_H
+
+// ioctl requests, responses and the response page of /dev/puf, shared with userspace tools.
+
+#include <linux/types.h>
+#ifdef __KERNEL__
+#include <linux/ioctl.h>
+#else
+#include <sys/ioctl.h>
+#endif
+
+#define PUF_IOC_MAGIC           'P'
+
+// A single response returned by read(), tagged with the index of its window.
+struct puf_response {
+    __u32 index;
+    __u32 response;
+};
+
+// Enrollment (the bytes a protected binary writes to /dev/puf) registered for pre-decay.
+struct puf_predecay_enrollment {
+    __u64 data;     // pointer to the enrollment.
+    __u32 len;      // its length in bytes.
+    __u32 reserved;
+};
+
+// Drops every cached response, takes no argument. Needs CAP_SYS_ADMIN.
+#define PUF_IOC_FLUSH_CACHE         _IO(PUF_IOC_MAGIC, 0x1)
+// Registers an enrollment to be decayed in the background ahead of the process
+// presenting it, replacing the one registered for its slot. Needs CAP_SYS_ADMIN.
+#define PUF_IOC_PREDECAY_REGISTER   _IOW(PUF_IOC_MAGIC, 0x2, struct puf_predecay_enrollment)
+// Drops all registered enrollments and stops their pre-decay, takes no argument.
+// Needs CAP_SYS_ADMIN.
+#define PUF_IOC_PREDECAY_CLEAR      _IO(PUF_IOC_MAGIC, 0x3)
+
+// Page mapped read-only with mmap(NULL, PUF_PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0)
+// by an enrolled session. Once mapped, the response of each window is published to
+// the page as soon as its decay time elapsed and is no longer returned by read().
+//
+// The page is updated under a sequence counter, seq is odd while the kernel writes.
+// A reader loads seq (acquire), the window, then seq again after an acquire fence,
+// and retries if seq was odd or changed in between.
+#define PUF_PAGE_SIZE           4096
+#define PUF_PAGE_MAX_WINDOWS    ((PUF_PAGE_SIZE - 2 * sizeof(__u32)) / sizeof(struct puf_page_window))
+
+struct puf_page_window {
+    __u32 ready;    // non-zero once response holds the response of the window.
+    __u32 response;
+};
+
+struct puf_response_page {
+    __u32                  seq;
+    __u32                  count;  // number of windows of the enrollment.
+    struct puf_page_window windows[];
+};
+
+#endif // PUF_IOCTL_H
@@ -1,15 +1,33 @@
 static uint32_t puf_size = 0x0;
-module_param(puf_size, uint, 0);
+module_param(puf_size, uint, 0444);
 
 static uint32_t puf_phys_addr = 0x0;
 module_param(puf_phys_addr, uint, 0);
 
+static uint32_t puf_slots = 1;
+module_param(puf_slots, uint, 0444);
+MODULE_PARM_DESC(puf_slots, "number of equally sized slots the PUF region is split into, one process per slot (default 1)");
+
 void*    puf_addr        = 0x0;
 
 uint32_t temp_total      = 0x0;
 uint32_t temp_poll_count = 0x0;
+uint32_t temp_last       = 0x0;   // latest DTEMP code of the bandgap sensor.
+
+// Temperature compensation of the decay windows, see common/retention.h.
+static uint32_t retention_halving = 10;
+module_param(retention_halving, uint, 0644);
+MODULE_PARM_DESC(retention_halving, "DTEMP codes of temperature rise halving the retention, used unless the enrollment carries its own (default 10, 0 disables the compensation)");
+
+// Software refresh, see common/refresh.h.
+static struct refresh_range  sdram_excluded[1];
+static struct refresh_engine sdram_engine;
+static struct refresh_runner sdram_runner;
+
+// Holders of the disabled hardware refresh, the warm up and every decaying slot.
+static uint32_t refresh_holders = 0x0;
+static DEFINE_MUTEX(refresh_holders_lock);
 
-static struct delayed_work work_sdram;
 static struct delayed_work work_temp_poll;
 
 void temp_polling(struct work_struct *work) {
@@ -25,27 +43,40 @@ void temp_polling(struct work_struct *work) {
 
     temp_total      += temp;
     temp_poll_count += 1;
+    WRITE_ONCE(temp_last, temp);
 }
 
-void sdram_refresh(struct work_struct *work) {
-    uint32_t discard, offset;
-    uint32_t puf_beg, puf_end;
+// Decay time of a window enrolled at the reference temperature, scaled to the current one.
+uint32_t compensate_decay(uint32_t decay_ms, int32_t reference, uint32_t halving) {
+    if (reference < 0 || temp_poll_count == 0) {
+        return decay_ms;
+    }
+    return retention_scale_ms(decay_ms, READ_ONCE(temp_last), reference, halving ? halving : retention_halving);
+}
 
-    struct delayed_work *dwork;
+void sdram_refresh_pass(struct refresh_engine *engine) {
+    trace_puf_refresh_pass(engine->last_busy_ns, engine->last_interval_ns, engine->last_rows);
+    if (engine->last_interval_ns > (uint64_t) engine->deadline_ms * NSEC_PER_MSEC) {
+        puf_dbg("debug: refresh pass started %llu us after the previous one\n", engine->last_interval_ns / 1000);
+    }
+}
 
-    dwork = to_delayed_work(work);
-    schedule_delayed_work(dwork, msecs_to_jiffies(REFRESH_PERIOD));
+// Sets up the software refresh of the SDRAM outside of the PUF region,
+// needs to be called once the PUF region is known.
+int init_sdram_refresh(void) {
+    int err;
 
-    puf_beg = puf_phys_addr;
-    puf_end = puf_phys_addr + puf_size;
+    sdram_excluded[0].beg = puf_phys_addr;
+    sdram_excluded[0].end = puf_phys_addr + puf_size;
 
-    for (offset = DDR_BASE; offset <= DDR_END; offset += ROW_SIZE) {
-        if (offset >= puf_beg && offset < puf_end) {
-            offset = puf_end - ROW_SIZE;
-            continue;
-        }
-        phys_r32(offset, &discard);
+    err = refresh_setup(&sdram_runner, &sdram_engine, DDR_BASE, DDR_END + 1, (uint8_t *) phys_to_virt(DDR_BASE),
+                        ROW_SIZE, sdram_excluded, ARRAY_SIZE(sdram_excluded), REFRESH_PERIOD);
+    if (err) {
+        return err;
     }
+    sdram_runner.on_pass = sdram_refresh_pass;
+
+    return 0;
 }
 
 void disable_sdram_refresh(void) {
@@ -53,14 +84,14 @@ void disable_sdram_refresh(void) {
     hw_reg_r32(SDRAM_REF_CTRL, &rctrl);
     hw_reg_r32(SDRAM_REF_CTRL_SDHW, &rctrl_sdhw);
 
-    printk(KERN_INFO "DISABLE, RCTRL=0x%08x\n", rctrl);
-    printk(KERN_INFO "DISABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
+    puf_dbg("DISABLE, RCTRL=0x%08x\n", rctrl);
+    puf_dbg("DISABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
 
     rctrl |= DISABLE_REFRESH;
     rctrl_sdhw |= DISABLE_REFRESH;
 
-    printk(KERN_INFO "DISABLE, RCTRL=0x%08x\n", rctrl);
-    printk(KERN_INFO "DISABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
+    puf_dbg("DISABLE, RCTRL=0x%08x\n", rctrl);
+    puf_dbg("DISABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
 
     hw_reg_w32(SDRAM_REF_CTRL, rctrl);
     hw_reg_w32(SDRAM_REF_CTRL_SDHW, rctrl_sdhw);
@@ -71,22 +102,31 @@ void enable_sdram_refresh(void) {
     hw_reg_r32(SDRAM_REF_CTRL, &rctrl);
     hw_reg_r32(SDRAM_REF_CTRL_SDHW, &rctrl_sdhw);
 
-    printk(KERN_INFO "ENABLE, RCTRL=0x%08x\n", rctrl);
-    printk(KERN_INFO "ENABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
+    puf_dbg("ENABLE, RCTRL=0x%08x\n", rctrl);
+    puf_dbg("ENABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
 
     rctrl &= ~DISABLE_REFRESH;
     rctrl_sdhw &= ~DISABLE_REFRESH;
 
-    printk(KERN_INFO "ENABLE, RCTRL=0x%08x\n", rctrl);
-    printk(KERN_INFO "ENABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
+    puf_dbg("ENABLE, RCTRL=0x%08x\n", rctrl);
+    puf_dbg("ENABLE, RCTRL_SDHW=0x%08x\n", rctrl_sdhw);
 
     hw_reg_w32(SDRAM_REF_CTRL, rctrl);
     hw_reg_w32(SDRAM_REF_CTRL_SDHW, rctrl_sdhw);
 }
 
-void start_puf(void) {
+int start_puf(void) {
+    error err;
+
+    // the software refresh has to run before the hardware one is disabled.
+    err = refresh_start(&sdram_runner);
+    if (err) {
+        printk(KERN_ERR "failed to start the software refresh\n");
+        return err;
+    }
+
     disable_sdram_refresh();
-    schedule_delayed_work(&work_sdram, msecs_to_jiffies(REFRESH_PERIOD));
+    return 0;
 }
 
 void start_temp_polling(void) {
@@ -108,9 +148,41 @@ void stop_temp_polling(void) {
 
     printk(KERN_INFO "Temp Total=%d\n", temp_total);
     printk(KERN_INFO "Poll count=%d\n", temp_poll_count);
+    if (temp_poll_count != 0) {
+        printk(KERN_INFO "Temp Avg=%d\n", temp_total / temp_poll_count);
+    }
 }
 
 void end_puf(void) {
     enable_sdram_refresh();
-    cancel_delayed_work_sync(&work_sdram);
+    refresh_stop(&sdram_runner);
+}
+
+// Disables the hardware refresh for the caller, unless it is already disabled
+// for another one.
+int get_puf(void) {
+    error err = 0;
+
+    mutex_lock(&refresh_holders_lock);
+    if (refresh_holders == 0) {
+        err = start_puf();
+    }
+    if (!err) {
+        refresh_holders++;
+    }
+    mutex_unlock(&refresh_holders_lock);
+
+    return err;
+}
+
+// Enables the hardware refresh once its last holder is done.
+void put_puf(void) {
+    mutex_lock(&refresh_holders_lock);
+    if (refresh_holders > 0) {
+        refresh_holders--;
+        if (refresh_holders == 0) {
+            end_puf();
+        }
+    }
+    mutex_unlock(&refresh_holders_lock);
 }
@@ -0,0 +1,62 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM puf
+
+#if !defined(_PUF_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PUF_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// Reconstruction of the response of a single decay window of a slot.
+// corrected is the number of bits fixed by the ECC, negative if uncorrectable.
+TRACE_EVENT(puf_read_window,
+    TP_PROTO(u32 slot, u32 index, s64 latency_ns, int corrected),
+    TP_ARGS(slot, index, latency_ns, corrected),
+
+    TP_STRUCT__entry(
+        __field(u32, slot)
+        __field(u32, index)
+        __field(s64, latency_ns)
+        __field(int, corrected)
+    ),
+
+    TP_fast_assign(
+        __entry->slot       = slot;
+        __entry->index      = index;
+        __entry->latency_ns = latency_ns;
+        __entry->corrected  = corrected;
+    ),
+
+    TP_printk("slot=%u window=%u latency_ns=%lld corrected=%d",
+              __entry->slot, __entry->index, __entry->latency_ns, __entry->corrected)
+);
+
+// A single pass of the software refresh over the SDRAM outside of the PUF region.
+// busy is the time spent touching the rows, interval the time since the previous pass.
+TRACE_EVENT(puf_refresh_pass,
+    TP_PROTO(u64 busy_ns, u64 interval_ns, u32 rows),
+    TP_ARGS(busy_ns, interval_ns, rows),
+
+    TP_STRUCT__entry(
+        __field(u64, busy_ns)
+        __field(u64, interval_ns)
+        __field(u32, rows)
+    ),
+
+    TP_fast_assign(
+        __entry->busy_ns     = busy_ns;
+        __entry->interval_ns = interval_ns;
+        __entry->rows        = rows;
+    ),
+
+    TP_printk("busy_ns=%llu interval_ns=%llu rows=%u",
+              __entry->busy_ns, __entry->interval_ns, __entry->rows)
+);
+
+#endif // _PUF_TRACE_H
+
+// the trace header lives next to the module sources, not in include/trace/events.
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE puf_trace
+#include <trace/define_trace.h>
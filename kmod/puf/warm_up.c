@@ -0,0 +1,97 @@
+// Warm up after the module is loaded, the PUF region is decayed in cycles of
+// warmup_period_s until the cells behave consistently, see warm_up.h.
+//
+// With warmup_cells set (pointers of cells known to be stable, in the format of
+// the enrollment) the warm up ends once they settle, at the latest after
+// warmup_max_cycles. Without them all warmup_max_cycles cycles are run.
+
+static uint32_t warmup_cells[PUF_WARM_UP_MAX_CELLS];
+static int      warmup_cells_count = 0;
+module_param_array(warmup_cells, uint, &warmup_cells_count, 0);
+MODULE_PARM_DESC(warmup_cells, "pointers (block << 4 | bit) of stable cells sampled after every warm up cycle");
+
+static uint32_t warmup_period_s = PUF_WARM_UP_PERIOD;
+module_param(warmup_period_s, uint, 0);
+MODULE_PARM_DESC(warmup_period_s, "seconds of a single warm up cycle (default 150)");
+
+static uint32_t warmup_max_cycles = PUF_WARM_UP_RETRY;
+module_param(warmup_max_cycles, uint, 0);
+MODULE_PARM_DESC(warmup_max_cycles, "warm up cycles run at most (default 4)");
+
+static struct delayed_work work_warm_up;
+
+struct warm_up_state warm_up_progress = {0};
+ktime_t warm_up_started = 0;
+
+void warm_up(struct work_struct *work) {
+    struct delayed_work *dwork;
+    bool done;
+
+    dwork = to_delayed_work(work);
+    done = warm_up_cycle(&warm_up_progress, puf_addr, warmup_cells, warmup_cells_count, warmup_max_cycles);
+    if (warmup_cells_count > 0) {
+        puf_dbg("debug: warm up cycle %u sample 0x%08x stable for %u\n", warm_up_progress.cycles,
+                warm_up_progress.sample, warm_up_progress.stable);
+    }
+
+    if (done) {
+        printk(KERN_INFO "PUF warm up completed after %u cycles (%lld s), can now be used\n",
+               warm_up_progress.cycles, ktime_ms_delta(ktime_get(), warm_up_started) / 1000);
+        put_puf();
+        puf_state = PUF_UNUSED;
+        return;
+    }
+
+    puf_dbg("debug: reseting PUF, left: %d\n", warmup_max_cycles - warm_up_progress.cycles);
+    memset(puf_addr, 0, puf_size);
+    schedule_delayed_work(dwork, msecs_to_jiffies(warmup_period_s * 1000));
+}
+
+int init_warm_up(void) {
+    int i;
+
+    if (warmup_period_s == 0 || warmup_max_cycles == 0) {
+        printk(KERN_ERR "warmup_period_s and warmup_max_cycles need to be non-zero\n");
+        return -EINVAL;
+    }
+
+    for (i = 0; i < warmup_cells_count; i++) {
+        if ((warmup_cells[i] >> 4) * sizeof(uint16_t) >= puf_size) {
+            printk(KERN_ERR "warm up cell %u is outside of the PUF\n", warmup_cells[i]);
+            return -EINVAL;
+        }
+    }
+
+    INIT_DELAYED_WORK(&work_warm_up, warm_up);
+    return 0;
+}
+
+void start_warm_up(void) {
+    printk(KERN_INFO "Starting PUF warmup");
+    warm_up_started = ktime_get();
+    schedule_delayed_work(&work_warm_up, msecs_to_jiffies(warmup_period_s * 1000));
+}
+
+void stop_warm_up(void) {
+    // the warm up holds the hardware refresh disabled until it completes.
+    if (cancel_delayed_work_sync(&work_warm_up)) {
+        put_puf();
+    }
+}
+
+// Progress under /sys/class/misc/puf/.
+static ssize_t warmup_cycles_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%u %u\n", warm_up_progress.cycles, warmup_max_cycles);
+}
+
+static ssize_t warmup_stable_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%u\n", warm_up_progress.stable);
+}
+
+static ssize_t ready_show(struct device *dev, struct device_attribute *attr, char *buf) {
+    return sysfs_emit(buf, "%d\n", puf_state != PUF_WARM_UP);
+}
+
+static DEVICE_ATTR_RO(warmup_cycles);
+static DEVICE_ATTR_RO(warmup_stable);
+static DEVICE_ATTR_RO(ready);
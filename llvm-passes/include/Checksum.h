@@ -12,6 +12,11 @@
 #define PARITY_INSTRUCTION_INT 66051
 
 struct Checksum {
+    // appended to the names of the generated functions, see PufPatcher::name_tag.
+    std::string name_tag;
+    // number of generated checksum functions.
+    uint32_t generated = 0;
+
     void run(
             llvm::Module &M,
             const std::vector<llvm::Function *> &funcs,
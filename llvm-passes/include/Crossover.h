@@ -1,6 +1,8 @@
 #ifndef LLVM_PUF_PATCHER_CROSSOVER_H
 #define LLVM_PUF_PATCHER_CROSSOVER_H
 
+#include <optional>
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 #include "json.hh"
@@ -19,6 +21,12 @@ namespace crossover {
                 {"take_offset_from_function", r.take_offset_from_function}
             };
         }
+
+        friend void from_json(const nlohmann::json &j, Replacement &r) {
+            j.at("puf_response").get_to(r.puf_response);
+            j.at("function").get_to(r.function);
+            j.at("take_offset_from_function").get_to(r.take_offset_from_function);
+        }
     };
 
     struct ReplacementsRequest {
@@ -27,11 +35,18 @@ namespace crossover {
         friend void to_json(nlohmann::json &j, const ReplacementsRequest &r) {
             j = nlohmann::json{{"replacements", r.replacements}};
         }
+
+        friend void from_json(const nlohmann::json &j, ReplacementsRequest &r) {
+            j.at("replacements").get_to(r.replacements);
+        }
     };
 
     // this will generate the a JSON with functions that have a known definition within the LLVM IR.
     void write_replacements_requests(const std::string &out_file, const ReplacementsRequest &funcs);
 
+    // concatenates the replacements of several modules in the order of the shards.
+    void merge_replacements_requests(const std::string &out_file, const std::vector<std::string> &shards);
+
     // -------------- Enrollment Related -----------------------
     struct Enrollment {
         int32_t decay_time{};
@@ -51,6 +66,22 @@ namespace crossover {
         std::vector<Enrollment> enrollments;
         std::vector<uint32_t> requests;
         uint32_t read_with_delay;
+        // unit of the decay times, requests and read delay, either "s" or "ms".
+        std::string time_unit = "s";
+        // DTEMP code of the bandgap sensor the decay times were measured at, if known.
+        std::optional<uint8_t> temperature;
+        // DTEMP codes of temperature rise halving the retention, 0 leaves it to the kernel module.
+        uint8_t retention_halving = 0;
+        // code of the parity, "bits" (one symbol per response bit) or "packed" (the 4 response bytes).
+        std::string ecc = "bits";
+
+        [[nodiscard]] bool packed() const {
+            return ecc == "packed";
+        }
+
+        [[nodiscard]] uint32_t to_millis(uint32_t time) const {
+            return time_unit == "ms" ? time : time * 1000;
+        }
 
         [[nodiscard]] const Enrollment *request_at(uint32_t request_timeout) const {
             uint32_t decay_timeout = requests[request_timeout];
@@ -68,6 +99,21 @@ namespace crossover {
             j.at("enrollments").get_to(ed.enrollments);
             j.at("requests").get_to(ed.requests);
             j.at("read_with_delay").get_to(ed.read_with_delay);
+            if (j.contains("time_unit")) {
+                j.at("time_unit").get_to(ed.time_unit);
+            }
+            if (j.contains("temperature")) {
+                ed.temperature = j.at("temperature").get<uint8_t>();
+            }
+            if (j.contains("retention_halving")) {
+                j.at("retention_halving").get_to(ed.retention_halving);
+            }
+            if (j.contains("ecc")) {
+                j.at("ecc").get_to(ed.ecc);
+                if (ed.ecc != "bits" && ed.ecc != "packed") {
+                    throw std::runtime_error("unsupported ecc \"" + ed.ecc + "\" in the enrollment");
+                }
+            }
         }
     };
 
@@ -106,6 +152,10 @@ namespace crossover {
     // this will read out the modified functions, where functions that were present in the LLVM IR
     // are not present in the final binary (possibly due to optimization)
     std::unordered_map<std::string, crossover::MetadataRequest> read_func_response(const std::string &in_file);
+
+    // concatenates the function metadata of several modules in the order of the shards,
+    // a function defined by several modules keeps the metadata of the first one.
+    void merge_func_requests(const std::string &out_file, const std::vector<std::string> &shards);
 }
 
 #endif //LLVM_PUF_PATCHER_CROSSOVER_H
@@ -1,6 +1,8 @@
 #ifndef LLVM_PUF_PARSER_H
 #define LLVM_PUF_PARSER_H
 
+#include <optional>
+#include <string>
 #include <vector>
 #include <set>
 
@@ -15,6 +17,7 @@
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
 
 // The binary will be loaded at memory offset 0x40000000
 // one can identify this from ldd ./program
@@ -23,23 +26,92 @@
 // and we can directly use the offset of the functions.
 #define BINARY_BASE_OFFSET 0x40000000
 
+// Logging performed by the generated PUF reader thread.
+enum class PufLogLevel {
+    // no logging, no stdio dependencies are declared.
+    None,
+    // counters are kept in the ____puf_stats____ global.
+    Stats,
+    // every response is printed to stdout.
+    Debug,
+};
+
+// Indices of the counters in ____puf_stats____.
+enum PufStatsCounter : uint32_t {
+    // responses read from the device.
+    PUF_STATS_RESPONSES = 0,
+    // reads that did not return a full response.
+    PUF_STATS_READ_FAILURES,
+    PUF_STATS_COUNT,
+};
+
+// How the responses reach the gates in the protected binary.
+enum class ResponseMode {
+    // a reader thread copies the responses returned by read() into ____puf_array____.
+    Read,
+    // the gates load the responses from the response page of /dev/puf
+    // mapped by the constructor, no reader thread is spawned.
+    Page,
+};
+
+// Scheduling policy of the generated PUF reader thread.
+enum class ReaderPolicy : int32_t {
+    // keep the policy inherited from the constructor.
+    Inherit = -1,
+    Batch = TARGET_SCHED_BATCH,
+    Idle = TARGET_SCHED_IDLE,
+};
+
+// Scheduling attributes of the generated PUF reader thread.
+struct ReaderThreadConfig {
+    ReaderPolicy policy = ReaderPolicy::Inherit;
+    // nice level of the thread, 0 keeps the inherited one.
+    int32_t nice = 0;
+    // CPUs the thread may run on (bit N = CPU N), 0 keeps the inherited mask.
+    uint32_t cpu_mask = 0;
+    // stack size in bytes, 0 keeps the libc default.
+    uint32_t stack_size = 0;
+};
+
+// Files read and written by the pass for a module.
+struct PufPatcherFiles {
+    // function metadata of the module for elf-parser, not written if empty.
+    std::string functions_out;
+    // function metadata the module is patched against, nothing is patched if empty.
+    std::string functions_in;
+    // replacements of the reference value markers for elf-parser.
+    std::string replacements_out;
+};
+
+// Files given by -outputjson, -inputjson and -replacementsjson.
+PufPatcherFiles command_line_files();
+
 struct LibCDependencies {
     // External functions used within the LLVM pass.
     llvm::PointerType *printf_arg_type = nullptr;
     llvm::FunctionCallee printf_func;
 
-    llvm::FunctionCallee sleep_func;
     llvm::FunctionCallee fflush_func;
 
     llvm::FunctionCallee pthread_attr_init_func;
     llvm::FunctionCallee pthread_attr_setdetachstate_func;
     llvm::FunctionCallee pthread_create_func;
+    llvm::FunctionCallee pthread_attr_setstacksize_func;
+
+    llvm::FunctionCallee sched_setscheduler_func;
+    llvm::FunctionCallee sched_setaffinity_func;
+    llvm::FunctionCallee setpriority_func;
 
     llvm::FunctionCallee open_func;
+    llvm::FunctionCallee socket_func;
+    llvm::FunctionCallee connect_func;
+    llvm::FunctionCallee shutdown_func;
     llvm::FunctionCallee close_func;
     llvm::FunctionCallee write_func;
     llvm::FunctionCallee read_func;
+    llvm::FunctionCallee errno_location_func;
     llvm::FunctionCallee exit_func;
+    llvm::FunctionCallee mmap_func;
 
     llvm::FunctionCallee rand_func;
 };
@@ -47,6 +119,11 @@ struct LibCDependencies {
 struct GlobalVariables {
     llvm::GlobalVariable *puf_fd = nullptr;
     llvm::GlobalVariable *stdoutput = nullptr;
+    llvm::GlobalVariable *puf_stats = nullptr;
+    // scales the index of each response, stays 1 only if the checksums match.
+    llvm::GlobalVariable *puf_arr_offset = nullptr;
+    // response page of /dev/puf, only with ResponseMode::Page.
+    llvm::GlobalVariable *puf_page = nullptr;
 };
 
 struct PufPatcher : public llvm::PassInfoMixin<PufPatcher> {
@@ -57,6 +134,22 @@ struct PufPatcher : public llvm::PassInfoMixin<PufPatcher> {
         std::pair<llvm::GlobalVariable*, std::string> reference_value_marker;
     };
 
+    PufLogLevel log_level = PufLogLevel::None;
+    ResponseMode response_mode = ResponseMode::Read;
+    ReaderThreadConfig reader_config;
+    // path of the unix socket of the PUF broker, the device is used directly if empty.
+    std::string broker_path;
+
+    // files of the module, the command line ones if not set (see tools/puf-patch).
+    std::optional<PufPatcherFiles> files;
+    // appended to the names of the generated functions, keeps them unique
+    // across the modules of a binary patched by the same process.
+    std::string name_tag;
+    // debug output of the pass.
+    llvm::raw_ostream *log = &llvm::outs();
+    // number of generated reference value functions.
+    uint32_t reference_values = 0;
+
     GlobalVariables global_variables;
     LibCDependencies lib_c_dependencies;
     Checksum checksum;
@@ -85,13 +178,18 @@ struct PufPatcher : public llvm::PassInfoMixin<PufPatcher> {
             llvm::GlobalVariable *Fd
     );
 
+    uint32_t inline_small_callees(
+            llvm::Module &M,
+            const std::vector<llvm::Function *> &funcs
+    );
+
     std::pair<llvm::GlobalVariable *, std::map<llvm::Function *, uint32_t>>
     replace_calls_with_lookup_table(
             llvm::Module &M,
             const std::vector<llvm::Function *> &funcs
     );
 
-    llvm::GlobalVariable *spawn_puf_thread(
+    void spawn_puf_thread(
             llvm::Module &M,
             const std::pair<llvm::GlobalVariable *, size_t> &puf_array,
             llvm::BasicBlock *const bb_to_add_code,
@@ -103,6 +201,12 @@ struct PufPatcher : public llvm::PassInfoMixin<PufPatcher> {
             const crossover::EnrollData &
     );
 
+    std::pair<llvm::Value *, llvm::Value *> load_page_response(
+            llvm::IRBuilder<> &Builder,
+            llvm::Value *puf_arr_index,
+            size_t puf_array_size
+    );
+
     void generate_block_until_puf_response(
             const std::pair<llvm::GlobalVariable *, std::map<llvm::Function *, uint32_t>> &lookup_table,
             llvm::Function *function_to_add_code,
@@ -34,6 +34,40 @@
 #define DEV_FAIL 0x9c
 #define CKS_FAIL 0x9E
 
+// Version of the enrollment set header written to the PUF device,
+// |(8bit)version|(8bit)flags|(16bit)record count|.
+#define PUF_ENROLLMENT_VERSION 1
+#define PUF_SET_HEADER_SIZE 4
+// Version 2 headers are followed by the temperature the decay times were enrolled at,
+// |(8bit)reference DTEMP code|(8bit)DTEMP codes halving the retention, 0 if unknown|.
+#define PUF_ENROLLMENT_VERSION_TEMP 2
+#define PUF_SET_TEMP_SIZE 2
+// Flag of the sets whose parity protects the 4 response bytes, with 8bit parity values.
+#define PUF_SET_FLAG_PACKED 0x1
+
+// Values of the libc constants used by the generated code on the
+// target (armv7 linux). The host headers can't be used for these
+// as the pass may run on a different OS.
+#define TARGET_PRIO_PROCESS    0
+#define TARGET_SCHED_BATCH     3
+#define TARGET_SCHED_IDLE      5
+#define TARGET_PTHREAD_STACK_MIN 16384
+#define TARGET_AF_UNIX         1
+#define TARGET_SOCK_STREAM     1
+#define TARGET_SHUT_WR         1
+#define TARGET_UNIX_PATH_MAX   108
+#define TARGET_PROT_READ       1
+#define TARGET_MAP_SHARED      1
+#define TARGET_EINTR           4
+#define TARGET_EAGAIN          11
+#define TARGET_MAP_FAILED      -1
+
+// Response page of /dev/puf (kmod/puf/puf_ioctl.h), 32bit words
+// |seq|count| followed by |ready|response| per window.
+#define PUF_PAGE_SIZE          4096
+#define PUF_PAGE_HEADER_WORDS  2
+#define PUF_PAGE_MAX_WINDOWS   ((PUF_PAGE_SIZE / sizeof(uint32_t) - PUF_PAGE_HEADER_WORDS) / 2)
+
 inline std::mt19937_64 RandomRNG(uint32_t seed = 0x42) {
     return std::mt19937_64(seed);
 }
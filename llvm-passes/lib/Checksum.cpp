@@ -118,10 +118,9 @@ llvm::BasicBlock *Checksum::add_checksum(
 }
 
 llvm::Function *Checksum::generate_checksum_func_with_asm(llvm::Module &M) {
-    static int i = 0;
     auto &ctx = M.getContext();
 
-    std::string function_name = "s" + std::to_string(i++);
+    std::string function_name = "s" + name_tag + std::to_string(generated++);
     std::string address_label_name = function_name + "0";
     std::string count_label_name = function_name + "1";
     std::string constant_label_name = function_name + "2";
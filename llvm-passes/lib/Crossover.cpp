@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "Utils.h"
 #include "json.hh"
@@ -20,6 +21,9 @@ crossover::EnrollData crossover::read_enrollment_data(const std::string &file) {
     inputFile >> j;
 
     auto e = j.get<crossover::EnrollData>();
+    if (e.time_unit != "s" && e.time_unit != "ms") {
+        throw std::runtime_error("unsupported time_unit in enrollment data, expected \"s\" or \"ms\"");
+    }
     std::sort(e.requests.begin(), e.requests.end());
     return e;
 }
@@ -88,3 +92,57 @@ void crossover::write_replacements_requests(const std::string &out_file, const R
         throw std::runtime_error("unable to open file for writing");
     }
 }
+
+void crossover::merge_replacements_requests(const std::string &out_file, const std::vector<std::string> &shards) {
+    crossover::ReplacementsRequest merged;
+
+    for (auto &shard: shards) {
+        std::ifstream input(shard);
+        if (!input.is_open()) {
+            throw std::runtime_error("failed to open file");
+        }
+
+        nlohmann::json json;
+        input >> json;
+
+        auto replacements = json.get<crossover::ReplacementsRequest>();
+        merged.replacements.insert(
+                merged.replacements.end(),
+                replacements.replacements.begin(),
+                replacements.replacements.end()
+        );
+    }
+
+    crossover::write_replacements_requests(out_file, merged);
+}
+
+void crossover::merge_func_requests(const std::string &out_file, const std::vector<std::string> &shards) {
+    crossover::ReadRequest merged;
+    std::unordered_set<std::string> seen;
+
+    for (auto &shard: shards) {
+        std::ifstream input(shard);
+        if (!input.is_open()) {
+            throw std::runtime_error("failed to open file");
+        }
+
+        nlohmann::json json;
+        input >> json;
+
+        for (auto &f: json.get<crossover::ReadRequest>().function_metadata) {
+            if (seen.insert(f.function).second) {
+                merged.function_metadata.push_back(f);
+            }
+        }
+    }
+
+    nlohmann::json json = merged;
+
+    std::ofstream outputFile(out_file);
+    if (outputFile.is_open()) {
+        outputFile << json.dump(4);
+        outputFile.close();
+    } else {
+        throw std::runtime_error("unable to open file for writing");
+    }
+}
@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include <sys/fcntl.h>
 
 #include "PufPatcher.h"
@@ -20,12 +21,50 @@ PufPatcher::puf_open_ctor(
     );
 
     llvm::IRBuilder<> Builder(llvm::BasicBlock::Create(ctx, "entry", puf_func));
-    auto *fd = Builder.CreateCall(lib_c_dependencies.open_func, {
-            Builder.CreateGlobalStringPtr("/dev/puf"), Builder.getInt32(O_RDWR)
-    });
+    llvm::Value *fd = nullptr;
+    llvm::Value *is_not_open_fd = nullptr;
+    if (broker_path.empty()) {
+        fd = Builder.CreateCall(lib_c_dependencies.open_func, {
+                Builder.CreateGlobalStringPtr("/dev/puf"), Builder.getInt32(O_RDWR)
+        });
+        is_not_open_fd = Builder.CreateICmpSLT(fd, Builder.getInt32(0));
+    } else {
+        // The broker speaks the protocol of the device over a stream socket,
+        // only opening the connection differs.
+        // struct sockaddr_un { sa_family_t sun_family; char sun_path[108]; }
+        auto *sun_path_typ = llvm::ArrayType::get(LLVM_I8(ctx), TARGET_UNIX_PATH_MAX);
+        auto *sockaddr_typ = llvm::StructType::get(ctx, {LLVM_I16(ctx), sun_path_typ});
+
+        std::vector<uint8_t> sun_path(broker_path.begin(), broker_path.end());
+        sun_path.resize(TARGET_UNIX_PATH_MAX, 0x0);
+
+        auto *sockaddr = new llvm::GlobalVariable(
+                M,
+                sockaddr_typ,
+                true,
+                llvm::GlobalValue::PrivateLinkage,
+                llvm::ConstantStruct::get(sockaddr_typ, {
+                        llvm::ConstantInt::get(LLVM_I16(ctx), TARGET_AF_UNIX),
+                        llvm::ConstantDataArray::get(ctx, sun_path)
+                }),
+                "____puf_broker_addr____"
+        );
+
+        fd = Builder.CreateCall(lib_c_dependencies.socket_func, {
+                Builder.getInt32(TARGET_AF_UNIX), Builder.getInt32(TARGET_SOCK_STREAM), Builder.getInt32(0)
+        });
+        auto *connected = Builder.CreateCall(lib_c_dependencies.connect_func, {
+                fd,
+                Builder.CreatePointerCast(sockaddr, llvm::PointerType::getInt8PtrTy(ctx)),
+                Builder.getInt32(M.getDataLayout().getTypeAllocSize(sockaddr_typ))
+        });
+        is_not_open_fd = Builder.CreateOr(
+                Builder.CreateICmpSLT(fd, Builder.getInt32(0)),
+                Builder.CreateICmpSLT(connected, Builder.getInt32(0))
+        );
+    }
 
     // error handle the file descriptor.
-    auto *is_not_open_fd = Builder.CreateICmpSLT(fd, Builder.getInt32(0));
     auto *failed_bb = llvm::BasicBlock::Create(ctx, "error", puf_func);
     auto *success_bb = llvm::BasicBlock::Create(ctx, "continue", puf_func);
 
@@ -42,46 +81,120 @@ PufPatcher::puf_open_ctor(
     Builder.SetInsertPoint(success_bb);
     Builder.CreateStore(fd, Fd);
 
-    // Parity Bits + Cell Pointers
-    size_t array_length_bytes = 0;
-    for (auto &enrollment: enrollments.enrollments) {
-        // | parity length| parity bits| pointers bits|
+    // One record per requested response, in the order of the requests, so that the
+    // index of the decay window the kernel reports matches the index into the puf array.
+    std::vector<const crossover::Enrollment *> windows;
+    for (uint32_t i = 0; i < enrollments.requests.size(); i++) {
+        auto *enrollment = enrollments.request_at(i);
+        if (!enrollment) {
+            throw std::runtime_error("no enrollment for requested decay time " + std::to_string(enrollments.requests[i]));
+        }
+        windows.push_back(enrollment);
+    }
+
+    if (windows.size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("too many requested responses for a single enrollment set");
+    }
+
+    // Set Header + (Decay Time + Parity Bits + Cell Pointers) per record
+    // The kernel module scales the decay times to the temperature of the device
+    // if the set carries the temperature they were enrolled at.
+    size_t array_length_bytes = PUF_SET_HEADER_SIZE;
+    if (enrollments.temperature) {
+        array_length_bytes += PUF_SET_TEMP_SIZE;
+    }
+    // packed sets carry 8bit parity values.
+    size_t parity_size = enrollments.packed() ? sizeof(uint8_t) : sizeof(uint16_t);
+    for (auto *enrollment: windows) {
+        // | decay time ms | parity length| parity bits| pointers bits|
+        array_length_bytes += sizeof(uint32_t);
         array_length_bytes += 1;
-        array_length_bytes += enrollment.parity.size() * sizeof(uint16_t);
-        array_length_bytes += enrollment.pointers.size() * sizeof(uint32_t);
-        assert(enrollment.pointers.size() == 32); // should encode 32bits.
+        array_length_bytes += enrollment->parity.size() * parity_size;
+        array_length_bytes += enrollment->pointers.size() * sizeof(uint32_t);
+        assert(enrollment->pointers.size() == 32); // should encode 32bits.
     }
 
     std::vector<uint8_t> enrollment_data;
     enrollment_data.resize(array_length_bytes);
     uint32_t write_idx = 0;
 
-    for (auto &enrollment: enrollments.enrollments) {
-        fill_8bits(&write_idx, &enrollment_data[0], uint8_t(enrollment.parity.size()));
-        for (auto parity: enrollment.parity) {
-            fill_16bits(&write_idx, &enrollment_data[0], parity);
+    // | version | flags | record count | (reference temperature | halving)
+    fill_8bits(&write_idx, &enrollment_data[0],
+               enrollments.temperature ? PUF_ENROLLMENT_VERSION_TEMP : PUF_ENROLLMENT_VERSION);
+    fill_8bits(&write_idx, &enrollment_data[0], enrollments.packed() ? PUF_SET_FLAG_PACKED : 0x0);
+    fill_16bits(&write_idx, &enrollment_data[0], uint16_t(windows.size()));
+    if (enrollments.temperature) {
+        fill_8bits(&write_idx, &enrollment_data[0], *enrollments.temperature);
+        fill_8bits(&write_idx, &enrollment_data[0], enrollments.retention_halving);
+    }
+
+    for (uint32_t i = 0; i < windows.size(); i++) {
+        auto *enrollment = windows[i];
+        fill_32bits(&write_idx, &enrollment_data[0],
+                    enrollments.to_millis(enrollments.requests[i] + enrollments.read_with_delay));
+        fill_8bits(&write_idx, &enrollment_data[0], uint8_t(enrollment->parity.size()));
+        for (auto parity: enrollment->parity) {
+            if (enrollments.packed()) {
+                fill_8bits(&write_idx, &enrollment_data[0], uint8_t(parity));
+            } else {
+                fill_16bits(&write_idx, &enrollment_data[0], parity);
+            }
         }
-        for (auto ptr: enrollment.pointers) {
+        for (auto ptr: enrollment->pointers) {
             fill_32bits(&write_idx, &enrollment_data[0], ptr);
         }
     }
 
-    // Create Array with enrollment data.
-    std::vector<llvm::Constant *> llvm_arr_values;
-    llvm_arr_values.reserve(enrollment_data.size());
+    // Emit the enrollment data once as a read-only global and hand it
+    // directly to write(), without copying it to the stack first.
+    auto *llvm_enrollment_data = llvm::ConstantDataArray::get(ctx, enrollment_data);
+    auto *enrollment_global = new llvm::GlobalVariable(
+            M,
+            llvm_enrollment_data->getType(),
+            true,
+            llvm::GlobalValue::PrivateLinkage,
+            llvm_enrollment_data,
+            "____puf_enrollment____"
+    );
+    enrollment_global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    enrollment_global->setAlignment(llvm::Align(4));
+
+    // Write to PUF
+    Builder.CreateCall(lib_c_dependencies.write_func, {
+            fd, enrollment_global, LLVM_CONST_I32(ctx, array_length_bytes)
+    });
 
-    for (uint8_t val: enrollment_data) {
-        llvm_arr_values.push_back(llvm::ConstantInt::get(LLVM_I8(ctx), val));
+    // the broker reads the enrollment until the end of the stream.
+    if (!broker_path.empty()) {
+        Builder.CreateCall(lib_c_dependencies.shutdown_func, {fd, Builder.getInt32(TARGET_SHUT_WR)});
     }
 
-    auto *arr_type = llvm::ArrayType::get(LLVM_I8(ctx), array_length_bytes);
-    llvm::Constant *llvm_enrollment_data = llvm::ConstantArray::get(arr_type, llvm_arr_values);
+    // the kernel publishes the responses to the page as their windows elapse.
+    if (response_mode == ResponseMode::Page) {
+        auto *page = Builder.CreateCall(lib_c_dependencies.mmap_func, {
+                llvm::ConstantPointerNull::get(llvm::PointerType::getInt8PtrTy(ctx)),
+                Builder.getInt32(PUF_PAGE_SIZE),
+                Builder.getInt32(TARGET_PROT_READ),
+                Builder.getInt32(TARGET_MAP_SHARED),
+                fd,
+                Builder.getInt32(0)
+        });
+        auto *is_not_mapped = Builder.CreateICmpEQ(
+                Builder.CreatePtrToInt(page, LLVM_I32(ctx)),
+                Builder.getInt32(TARGET_MAP_FAILED)
+        );
 
-    // Write to PUF
-    auto llvm_arr = Builder.CreateAlloca(arr_type, nullptr, "enrollment_data");
-    Builder.CreateStore(llvm_enrollment_data, llvm_arr);
-    auto *llvm_arr_ptr = Builder.CreateBitCast(llvm_arr, llvm::PointerType::get(arr_type, 0));
-    Builder.CreateCall(lib_c_dependencies.write_func, {fd, llvm_arr_ptr, LLVM_CONST_I32(ctx, array_length_bytes)});
+        auto *map_failed_bb = llvm::BasicBlock::Create(ctx, "map_error", puf_func);
+        auto *mapped_bb = llvm::BasicBlock::Create(ctx, "mapped", puf_func);
+        Builder.CreateCondBr(is_not_mapped, map_failed_bb, mapped_bb);
+
+        Builder.SetInsertPoint(map_failed_bb);
+        Builder.CreateCall(lib_c_dependencies.exit_func, {Builder.getInt32(DEV_FAIL)});
+        Builder.CreateUnreachable();
+
+        Builder.SetInsertPoint(mapped_bb);
+        Builder.CreateStore(page, global_variables.puf_page);
+    }
 
     auto *exit_bb = llvm::BasicBlock::Create(ctx, "exit_block", puf_func);
 
@@ -113,21 +226,14 @@ llvm::Function *PufPatcher::puf_close_dtor(llvm::Module &M, llvm::GlobalVariable
     return puf_func;
 }
 
-llvm::GlobalVariable *PufPatcher::spawn_puf_thread(
+void PufPatcher::spawn_puf_thread(
         llvm::Module &M,
         const std::pair<llvm::GlobalVariable *, size_t> &puf_array,
         llvm::BasicBlock *const bb_to_add_code,
         const crossover::EnrollData &enrollments
 ) {
     auto &ctx = M.getContext();
-
-    auto *puf_arr_offset_global = new llvm::GlobalVariable(
-            M,
-            LLVM_I32(ctx),
-            false,
-            llvm::GlobalValue::LinkageTypes::InternalLinkage,
-            LLVM_CONST_I32(ctx, 1)
-    );
+    auto *puf_arr_offset_global = global_variables.puf_arr_offset;
 
     auto thread_function = llvm::Function::Create(
             llvm::FunctionType::get(
@@ -143,40 +249,51 @@ llvm::GlobalVariable *PufPatcher::spawn_puf_thread(
 
     llvm::IRBuilder<> Builder(llvm::BasicBlock::Create(thread_function->getContext(), "entry", thread_function));
 
-    // Create sleeps[...]
-    auto sleeps_arr_typ = llvm::ArrayType::get(LLVM_I32(ctx), enrollments.requests.size());
-    auto sleeps_arr_ptr = Builder.CreateAlloca(sleeps_arr_typ);
-
-    // Create puf array iterator = 0x0
+    // Create puf array iterator = 0x0, the number of responses received so far.
     auto *puf_array_iter_ptr = Builder.CreateAlloca(LLVM_I32(ctx));
     Builder.CreateStore(LLVM_CONST_I32(ctx, 0), puf_array_iter_ptr);
 
-    std::vector<llvm::Constant *> sleep_arr_data;
+    // Create struct { uint32_t index; uint32_t response; } responses[...], a single read
+    // returns the responses of all decay windows that elapsed, tagged with their index.
+    auto *response_typ = llvm::StructType::get(ctx, {LLVM_U32(ctx), LLVM_U32(ctx)});
+    auto *responses_arr_typ = llvm::ArrayType::get(response_typ, enrollments.requests.size());
+    auto *responses_arr_ptr = Builder.CreateAlloca(responses_arr_typ);
 
-    uint32_t last_sleep = 0x0;
-    for (int i = 0; i < enrollments.requests.size(); i++) {
-        uint32_t sleep_for = (enrollments.requests[i] - last_sleep) + enrollments.read_with_delay;
-        last_sleep = enrollments.requests[i] + enrollments.read_with_delay;
-        sleep_arr_data.push_back(LLVM_CONST_I32(ctx, sleep_for));
-    }
-    Builder.CreateStore(llvm::ConstantArray::get(sleeps_arr_typ, sleep_arr_data), sleeps_arr_ptr);
-
-    // Create puf_response  = 0x0;
-    auto *puf_response_ptr = Builder.CreateAlloca(LLVM_U32(ctx));
-    Builder.CreateStore(LLVM_CONST_I32(ctx, 0), puf_response_ptr);
+    // Create response iterator
+    auto *response_iter_ptr = Builder.CreateAlloca(LLVM_I32(ctx));
 
     auto &[puf_array_ptr, _] = puf_array;
 
-    // Debug print...
-    auto *printf_format_str = Builder.CreateGlobalStringPtr("PUF response: 0x%08x\n");
-    auto *format_str_ptr = Builder.CreatePointerCast(printf_format_str, lib_c_dependencies.printf_arg_type,
-                                                     "formatStr");
-
     auto *loop_header_bb = llvm::BasicBlock::Create(ctx, "loop_header", thread_function);
     auto *loop_body_bb = llvm::BasicBlock::Create(ctx, "loop_body", thread_function);
+    auto *read_bb = llvm::BasicBlock::Create(ctx, "read", thread_function);
+    auto *store_header_bb = llvm::BasicBlock::Create(ctx, "store_header", thread_function);
+    auto *store_body_bb = llvm::BasicBlock::Create(ctx, "store_body", thread_function);
     auto *loop_footer_bb = llvm::BasicBlock::Create(ctx, "loop_footer", thread_function);
     auto *exit_bb = llvm::BasicBlock::Create(ctx, "exit", thread_function);
 
+    // The reader mostly sleeps, move it out of the way of the application threads.
+    // With pid 0 these calls apply to the calling thread only.
+    if (reader_config.policy != ReaderPolicy::Inherit) {
+        auto *sched_param_ptr = Builder.CreateAlloca(LLVM_I32(ctx));
+        Builder.CreateStore(LLVM_CONST_I32(ctx, 0), sched_param_ptr);
+        Builder.CreateCall(lib_c_dependencies.sched_setscheduler_func, {
+                LLVM_CONST_I32(ctx, 0), LLVM_CONST_I32(ctx, int32_t(reader_config.policy)), sched_param_ptr
+        });
+    }
+    if (reader_config.nice != 0) {
+        Builder.CreateCall(lib_c_dependencies.setpriority_func, {
+                LLVM_CONST_I32(ctx, TARGET_PRIO_PROCESS), LLVM_CONST_I32(ctx, 0), LLVM_CONST_I32(ctx, reader_config.nice)
+        });
+    }
+    if (reader_config.cpu_mask != 0) {
+        auto *cpu_mask_ptr = Builder.CreateAlloca(LLVM_I32(ctx));
+        Builder.CreateStore(LLVM_CONST_I32(ctx, reader_config.cpu_mask), cpu_mask_ptr);
+        Builder.CreateCall(lib_c_dependencies.sched_setaffinity_func, {
+                LLVM_CONST_I32(ctx, 0), LLVM_CONST_I32(ctx, sizeof(uint32_t)), cpu_mask_ptr
+        });
+    }
+
     Builder.CreateBr(loop_header_bb);
     Builder.SetInsertPoint(loop_header_bb);
 
@@ -186,54 +303,154 @@ llvm::GlobalVariable *PufPatcher::spawn_puf_thread(
     );
     Builder.CreateCondBr(cond, exit_bb, loop_body_bb);
 
+    // The read blocks in the kernel until the next decay window elapsed.
     Builder.SetInsertPoint(loop_body_bb);
-    auto *current_sleep = Builder.CreateLoad(
-            LLVM_I32(ctx),
+    Builder.CreateBr(read_bb);
+
+    Builder.SetInsertPoint(read_bb);
+    auto *read_bytes = Builder.CreateCall(lib_c_dependencies.read_func, {
+            Builder.CreateLoad(LLVM_I32(ctx), global_variables.puf_fd),
+            responses_arr_ptr,
+            LLVM_CONST_I32(ctx, enrollments.requests.size() * 2 * sizeof(uint32_t))
+    });
+    // no more windows to read, the PUF was released or reset.
+    auto *checked_bb = llvm::BasicBlock::Create(ctx, "checked", thread_function);
+    auto *failed_bb = llvm::BasicBlock::Create(ctx, "failed", thread_function);
+    auto *received_bb = llvm::BasicBlock::Create(ctx, "received", thread_function);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(read_bytes, LLVM_CONST_I32(ctx, 0)), exit_bb, checked_bb);
+
+    Builder.SetInsertPoint(checked_bb);
+    Builder.CreateCondBr(Builder.CreateICmpSLT(read_bytes, LLVM_CONST_I32(ctx, 0)), failed_bb, received_bb);
+
+    // a read interrupted by a signal (or would block) is retried, any other
+    // error stops the reader the same way as a released PUF.
+    Builder.SetInsertPoint(failed_bb);
+    auto *err = Builder.CreateLoad(LLVM_I32(ctx), Builder.CreateCall(lib_c_dependencies.errno_location_func));
+    Builder.CreateCondBr(
+            Builder.CreateOr(
+                    Builder.CreateICmpEQ(err, LLVM_CONST_I32(ctx, TARGET_EINTR)),
+                    Builder.CreateICmpEQ(err, LLVM_CONST_I32(ctx, TARGET_EAGAIN))
+            ),
+            received_bb,
+            exit_bb
+    );
+
+    // a retried read received no responses.
+    Builder.SetInsertPoint(received_bb);
+    auto *read_failed = Builder.CreateICmpSLT(read_bytes, LLVM_CONST_I32(ctx, 0));
+    auto *received = Builder.CreateUDiv(
+            Builder.CreateSelect(read_failed, LLVM_CONST_I32(ctx, 0), read_bytes),
+            LLVM_CONST_I32(ctx, 2 * sizeof(uint32_t))
+    );
+
+    if (log_level == PufLogLevel::Stats) {
+        // the counters are only ever incremented, relaxed atomics are enough
+        // and do not contend with the application threads.
+        Builder.CreateAtomicRMW(
+                llvm::AtomicRMWInst::Add,
+                Builder.CreateInBoundsGEP(
+                        global_variables.puf_stats->getValueType(),
+                        global_variables.puf_stats,
+                        {LLVM_CONST_I32(ctx, 0), LLVM_CONST_I32(ctx, PUF_STATS_RESPONSES)}
+                ),
+                received,
+                llvm::MaybeAlign(),
+                llvm::AtomicOrdering::Monotonic
+        );
+        Builder.CreateAtomicRMW(
+                llvm::AtomicRMWInst::Add,
+                Builder.CreateInBoundsGEP(
+                        global_variables.puf_stats->getValueType(),
+                        global_variables.puf_stats,
+                        {LLVM_CONST_I32(ctx, 0), LLVM_CONST_I32(ctx, PUF_STATS_READ_FAILURES)}
+                ),
+                Builder.CreateZExt(read_failed, LLVM_I32(ctx)),
+                llvm::MaybeAlign(),
+                llvm::AtomicOrdering::Monotonic
+        );
+    }
+
+    Builder.CreateStore(LLVM_CONST_I32(ctx, 0), response_iter_ptr);
+    Builder.CreateBr(store_header_bb);
+
+    // for (response_iter = 0; response_iter < received; response_iter++)
+    Builder.SetInsertPoint(store_header_bb);
+    Builder.CreateCondBr(
+            Builder.CreateICmpULT(Builder.CreateLoad(LLVM_I32(ctx), response_iter_ptr), received),
+            store_body_bb,
+            loop_footer_bb
+    );
+
+    Builder.SetInsertPoint(store_body_bb);
+    auto *response_index = Builder.CreateLoad(
+            LLVM_U32(ctx),
             Builder.CreateInBoundsGEP(
-                    sleeps_arr_typ,
-                    sleeps_arr_ptr,
+                    responses_arr_typ,
+                    responses_arr_ptr,
                     {
                             LLVM_CONST_I32(ctx, 0),
-                            Builder.CreateLoad(LLVM_I32(ctx), puf_array_iter_ptr)
+                            Builder.CreateLoad(LLVM_I32(ctx), response_iter_ptr),
+                            LLVM_CONST_I32(ctx, 0)
                     }
             )
     );
-    Builder.CreateCall(lib_c_dependencies.sleep_func, {current_sleep});
-    Builder.CreateCall(lib_c_dependencies.read_func, {
-            Builder.CreateLoad(LLVM_I32(ctx), global_variables.puf_fd),
-            puf_response_ptr,
-            LLVM_CONST_I32(ctx, sizeof(uint32_t))
-    });
-    Builder.CreateCall(lib_c_dependencies.printf_func, {
-            format_str_ptr, Builder.CreateLoad(LLVM_U32(ctx), puf_response_ptr)
-    });
-    Builder.CreateCall(lib_c_dependencies.fflush_func, {
-            Builder.CreateLoad(global_variables.stdoutput->getValueType(), global_variables.stdoutput)
-    });
+    auto *response = Builder.CreateLoad(
+            LLVM_U32(ctx),
+            Builder.CreateInBoundsGEP(
+                    responses_arr_typ,
+                    responses_arr_ptr,
+                    {
+                            LLVM_CONST_I32(ctx, 0),
+                            Builder.CreateLoad(LLVM_I32(ctx), response_iter_ptr),
+                            LLVM_CONST_I32(ctx, 1)
+                    }
+            )
+    );
+
+    if (log_level == PufLogLevel::Debug) {
+        auto *printf_format_str = Builder.CreateGlobalStringPtr("PUF response[%u]: 0x%08x\n");
+        auto *format_str_ptr = Builder.CreatePointerCast(printf_format_str, lib_c_dependencies.printf_arg_type,
+                                                         "formatStr");
+        Builder.CreateCall(lib_c_dependencies.printf_func, {format_str_ptr, response_index, response});
+        Builder.CreateCall(lib_c_dependencies.fflush_func, {
+                Builder.CreateLoad(global_variables.stdoutput->getValueType(), global_variables.stdoutput)
+        });
+    }
+
+    // The slot of the response is its window index scaled by the offset, which is only 1
+    // if the checksum of the code matches. Out of range slots are dropped, leaving the
+    // gates waiting on them blocked.
+    auto *slot = Builder.CreateMul(response_index, Builder.CreateLoad(LLVM_I32(ctx), puf_arr_offset_global));
+    auto *store_bb = llvm::BasicBlock::Create(ctx, "store", thread_function);
+    auto *store_footer_bb = llvm::BasicBlock::Create(ctx, "store_footer", thread_function);
+    Builder.CreateCondBr(
+            Builder.CreateICmpULT(slot, LLVM_CONST_I32(ctx, enrollments.requests.size())),
+            store_bb,
+            store_footer_bb
+    );
+
+    Builder.SetInsertPoint(store_bb);
     auto puf_array_offset_ptr = Builder.CreateInBoundsGEP(
             puf_array_ptr->getValueType(),
             puf_array_ptr,
-            {
-                    LLVM_CONST_I32(ctx, 0),
-                    Builder.CreateLoad(LLVM_I32(ctx), puf_array_iter_ptr)
-            }
+            {LLVM_CONST_I32(ctx, 0), slot}
     );
     Builder.CreateStore(
-            Builder.CreateAdd(
-                    Builder.CreateLoad(LLVM_U32(ctx), puf_response_ptr),
-                    Builder.CreateLoad(LLVM_U32(ctx), puf_array_offset_ptr)
-            ),
+            Builder.CreateAdd(response, Builder.CreateLoad(LLVM_U32(ctx), puf_array_offset_ptr)),
             puf_array_offset_ptr
     );
+    Builder.CreateBr(store_footer_bb);
 
-    Builder.CreateBr(loop_footer_bb);
-    Builder.SetInsertPoint(loop_footer_bb);
+    Builder.SetInsertPoint(store_footer_bb);
+    Builder.CreateStore(
+            Builder.CreateAdd(Builder.CreateLoad(LLVM_I32(ctx), response_iter_ptr), LLVM_CONST_I32(ctx, 1)),
+            response_iter_ptr
+    );
+    Builder.CreateBr(store_header_bb);
 
+    Builder.SetInsertPoint(loop_footer_bb);
     Builder.CreateStore(
-            Builder.CreateAdd(
-                    Builder.CreateLoad(LLVM_I32(ctx), puf_array_iter_ptr),
-                    Builder.CreateLoad(LLVM_I32(ctx), puf_arr_offset_global)
-            ),
+            Builder.CreateAdd(Builder.CreateLoad(LLVM_I32(ctx), puf_array_iter_ptr), received),
             puf_array_iter_ptr
     );
 
@@ -261,6 +478,11 @@ llvm::GlobalVariable *PufPatcher::spawn_puf_thread(
 
         Builder.CreateCall(lib_c_dependencies.pthread_attr_init_func, {union_ptr});
         Builder.CreateCall(lib_c_dependencies.pthread_attr_setdetachstate_func, {union_ptr, LLVM_CONST_I32(ctx, 1)});
+        if (reader_config.stack_size != 0) {
+            Builder.CreateCall(lib_c_dependencies.pthread_attr_setstacksize_func, {
+                    union_ptr, LLVM_CONST_I32(ctx, reader_config.stack_size)
+            });
+        }
         Builder.CreateCall(lib_c_dependencies.pthread_create_func, {
                 thread_ptr,
                 union_ptr,
@@ -268,6 +490,4 @@ llvm::GlobalVariable *PufPatcher::spawn_puf_thread(
                 llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(ctx))
         });
     }
-
-    return puf_arr_offset_global;
 }
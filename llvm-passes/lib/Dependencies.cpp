@@ -35,51 +35,103 @@ void PufPatcher::init_deps(llvm::Module &M) {
             )
     );
 
-    global_variables.stdoutput = M.getGlobalVariable("stdout");
-    if (!global_variables.stdoutput) {
-        global_variables.stdoutput = new llvm::GlobalVariable(
-                M,
-                llvm::PointerType::getInt8PtrTy(ctx),
-                false,
-                llvm::GlobalValue::ExternalLinkage,
-                nullptr,
-                "stdout",
-                nullptr,
-                llvm::GlobalValue::NotThreadLocal,
-                std::nullopt,
-                true
+    if (reader_config.stack_size != 0) {
+        lib_c_dependencies.pthread_attr_setstacksize_func = M.getOrInsertFunction(
+                "pthread_attr_setstacksize",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {llvm::PointerType::getInt8PtrTy(ctx), LLVM_I32(ctx)},
+                        false
+                )
         );
     }
 
-    // bring printf, fflush and sleep into scope.
-    lib_c_dependencies.printf_arg_type = llvm::PointerType::getUnqual(LLVM_I8(ctx));
+    if (reader_config.policy != ReaderPolicy::Inherit) {
+        lib_c_dependencies.sched_setscheduler_func = M.getOrInsertFunction(
+                "sched_setscheduler",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), LLVM_I32(ctx), llvm::PointerType::getInt8PtrTy(ctx)},
+                        false
+                )
+        );
+    }
 
-    lib_c_dependencies.printf_func = M.getOrInsertFunction(
-            "printf",
-            llvm::FunctionType::get(
-                    LLVM_I32(ctx),
-                    lib_c_dependencies.printf_arg_type,
+    if (reader_config.nice != 0) {
+        lib_c_dependencies.setpriority_func = M.getOrInsertFunction(
+                "setpriority",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), LLVM_I32(ctx), LLVM_I32(ctx)},
+                        false
+                )
+        );
+    }
+
+    if (reader_config.cpu_mask != 0) {
+        lib_c_dependencies.sched_setaffinity_func = M.getOrInsertFunction(
+                "sched_setaffinity",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), LLVM_I32(ctx), llvm::PointerType::getInt8PtrTy(ctx)},
+                        false
+                )
+        );
+    }
+
+    // stdio is only pulled into the protected binary when debugging,
+    // as it takes the stdout lock shared with the application threads.
+    if (log_level == PufLogLevel::Debug) {
+        global_variables.stdoutput = M.getGlobalVariable("stdout");
+        if (!global_variables.stdoutput) {
+            global_variables.stdoutput = new llvm::GlobalVariable(
+                    M,
+                    llvm::PointerType::getInt8PtrTy(ctx),
+                    false,
+                    llvm::GlobalValue::ExternalLinkage,
+                    nullptr,
+                    "stdout",
+                    nullptr,
+                    llvm::GlobalValue::NotThreadLocal,
+                    std::nullopt,
                     true
-            )
-    );
+            );
+        }
 
-    lib_c_dependencies.sleep_func = M.getOrInsertFunction(
-            "sleep",
-            llvm::FunctionType::get(
-                    LLVM_I32(ctx),
-                    {LLVM_I32(ctx)},
-                    false
-            )
-    );
+        // bring printf and fflush into scope.
+        lib_c_dependencies.printf_arg_type = llvm::PointerType::getUnqual(LLVM_I8(ctx));
 
-    lib_c_dependencies.fflush_func = M.getOrInsertFunction(
-            "fflush",
-            llvm::FunctionType::get(
-                    LLVM_I32(ctx),
-                    {llvm::PointerType::getInt8PtrTy(ctx)},
-                    false
-            )
-    );
+        lib_c_dependencies.printf_func = M.getOrInsertFunction(
+                "printf",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        lib_c_dependencies.printf_arg_type,
+                        true
+                )
+        );
+
+        lib_c_dependencies.fflush_func = M.getOrInsertFunction(
+                "fflush",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {llvm::PointerType::getInt8PtrTy(ctx)},
+                        false
+                )
+        );
+    }
+
+    if (log_level == PufLogLevel::Stats) {
+        auto *stats_typ = llvm::ArrayType::get(LLVM_I32(ctx), PUF_STATS_COUNT);
+        global_variables.puf_stats = new llvm::GlobalVariable(
+                M,
+                stats_typ,
+                false,
+                llvm::GlobalValue::InternalLinkage,
+                llvm::ConstantAggregateZero::get(stats_typ),
+                "____puf_stats____"
+        );
+        llvm::appendToCompilerUsed(M, {global_variables.puf_stats});
+    }
 
     lib_c_dependencies.close_func = M.getOrInsertFunction(
             "close",
@@ -108,6 +160,16 @@ void PufPatcher::init_deps(llvm::Module &M) {
             )
     );
 
+    // errno of the calling thread, int *__errno_location(void).
+    lib_c_dependencies.errno_location_func = M.getOrInsertFunction(
+            "__errno_location",
+            llvm::FunctionType::get(
+                    llvm::PointerType::getUnqual(LLVM_I32(ctx)),
+                    {},
+                    false
+            )
+    );
+
     lib_c_dependencies.exit_func = M.getOrInsertFunction(
             "exit",
             llvm::FunctionType::get(
@@ -128,6 +190,42 @@ void PufPatcher::init_deps(llvm::Module &M) {
         );
     }
 
+    global_variables.puf_arr_offset = new llvm::GlobalVariable(
+            M,
+            LLVM_I32(ctx),
+            false,
+            llvm::GlobalValue::LinkageTypes::InternalLinkage,
+            LLVM_CONST_I32(ctx, 1)
+    );
+
+    if (response_mode == ResponseMode::Page) {
+        // void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+        lib_c_dependencies.mmap_func = M.getOrInsertFunction(
+                "mmap",
+                llvm::FunctionType::get(
+                        llvm::PointerType::getInt8PtrTy(ctx),
+                        {
+                                llvm::PointerType::getInt8PtrTy(ctx),
+                                LLVM_I32(ctx),
+                                LLVM_I32(ctx),
+                                LLVM_I32(ctx),
+                                LLVM_I32(ctx),
+                                LLVM_I32(ctx)
+                        },
+                        false
+                )
+        );
+
+        global_variables.puf_page = new llvm::GlobalVariable(
+                M,
+                llvm::PointerType::getInt8PtrTy(ctx),
+                false,
+                llvm::GlobalValue::InternalLinkage,
+                llvm::ConstantPointerNull::get(llvm::PointerType::getInt8PtrTy(ctx)),
+                "____puf_page____"
+        );
+    }
+
     lib_c_dependencies.open_func = M.getOrInsertFunction("open", llvm::FunctionType::get(
             LLVM_I32(ctx),
             {
@@ -136,6 +234,35 @@ void PufPatcher::init_deps(llvm::Module &M) {
             },
             false
     ));
+
+    if (!broker_path.empty()) {
+        lib_c_dependencies.socket_func = M.getOrInsertFunction(
+                "socket",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), LLVM_I32(ctx), LLVM_I32(ctx)},
+                        false
+                )
+        );
+
+        lib_c_dependencies.connect_func = M.getOrInsertFunction(
+                "connect",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), llvm::PointerType::getInt8PtrTy(ctx), LLVM_I32(ctx)},
+                        false
+                )
+        );
+
+        lib_c_dependencies.shutdown_func = M.getOrInsertFunction(
+                "shutdown",
+                llvm::FunctionType::get(
+                        LLVM_I32(ctx),
+                        {LLVM_I32(ctx), LLVM_I32(ctx)},
+                        false
+                )
+        );
+    }
 }
 
 std::pair<llvm::GlobalVariable *, size_t>
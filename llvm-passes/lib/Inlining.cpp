@@ -0,0 +1,153 @@
+#include "PufPatcher.h"
+
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+static llvm::cl::opt<uint32_t> InlineThreshold(
+        "puf-inline-threshold",
+        llvm::cl::desc("calls between patched functions to callees with at most this many instructions are inlined "
+                       "before they are replaced with indirect calls via the lookup table. 0 disables inlining"),
+        llvm::cl::value_desc("number"),
+        llvm::cl::Optional,
+        llvm::cl::init(16)
+);
+
+static llvm::cl::opt<uint32_t> MinProtectedFunctions(
+        "puf-min-protected",
+        llvm::cl::desc("inlining stops before the number of distinct functions called via the lookup table "
+                       "drops below this value"),
+        llvm::cl::value_desc("number"),
+        llvm::cl::Optional,
+        llvm::cl::init(8)
+);
+
+uint32_t PufPatcher::inline_small_callees(llvm::Module &M, const std::vector<llvm::Function *> &funcs) {
+    if (InlineThreshold.getValue() == 0) {
+        return 0;
+    }
+
+    std::set<llvm::Function *> patched(funcs.begin(), funcs.end());
+
+    // to guarantee the same traversal each time the keys in the maps need to be
+    // deterministic on each run.
+    struct MapKey {
+        llvm::Function *function = nullptr;
+        std::string key;
+    };
+
+    struct MapKeyComparison {
+        bool operator()(const MapKey &lhs, const MapKey &rhs) const {
+            return lhs.key < rhs.key;
+        }
+    };
+
+    // collect the calls that would end up as indirect calls via the lookup table.
+    std::map<MapKey, std::vector<llvm::CallBase *>, MapKeyComparison> calls_per_callee;
+    for (auto f: funcs) {
+        for (auto &bb: *f) {
+            for (auto &i: bb) {
+                if (auto *call = llvm::dyn_cast<llvm::CallBase>(&i); call) {
+                    auto *callee = call->getCalledFunction();
+                    if (!callee || callee->isIntrinsic() || patched.find(callee) == patched.end()) {
+                        continue;
+                    }
+                    calls_per_callee[MapKey{callee, callee->getName().str()}].push_back(call);
+                }
+            }
+        }
+    }
+
+    // smallest callees first, so that when the floor is hit the remaining
+    // protected functions are the bigger ones.
+    std::vector<MapKey> callees;
+    for (auto &[key, _]: calls_per_callee) {
+        callees.push_back(key);
+    }
+    std::stable_sort(callees.begin(), callees.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.function->getInstructionCount() < rhs.function->getInstructionCount();
+    });
+
+    size_t protected_functions = calls_per_callee.size();
+    int64_t indirect_calls = 0;
+    for (auto &[_, calls]: calls_per_callee) {
+        indirect_calls += calls.size();
+    }
+    const int64_t initial_indirect_calls = indirect_calls;
+    uint32_t inlined = 0;
+
+    std::set<llvm::Function *> processed;
+    // callees with none of their calls left via the lookup table.
+    std::set<llvm::Function *> unprotected;
+
+    for (auto &key: callees) {
+        auto *callee = key.function;
+        if (callee->getInstructionCount() > InlineThreshold.getValue()) {
+            break;
+        }
+        if (protected_functions <= MinProtectedFunctions.getValue()) {
+            break;
+        }
+        processed.insert(callee);
+        if (callee->isVarArg() || callee->hasFnAttribute(llvm::Attribute::NoInline)) {
+            continue;
+        }
+        if (!llvm::isInlineViable(*callee).isSuccess()) {
+            continue;
+        }
+
+        bool all_inlined = true;
+        for (auto *call: calls_per_callee[key]) {
+            // do not unroll recursion.
+            if (call->getFunction() == callee) {
+                all_inlined = false;
+                continue;
+            }
+
+            llvm::InlineFunctionInfo info;
+            if (!llvm::InlineFunction(*call, info).isSuccess()) {
+                all_inlined = false;
+                continue;
+            }
+            inlined++;
+            indirect_calls--;
+
+            // calls of the callee to patched functions are cloned into the caller, those
+            // to callees still ahead are inlined with the others, the rest stay indirect.
+            for (auto *cloned: info.InlinedCallSites) {
+                auto *target = cloned->getCalledFunction();
+                if (!target || target->isIntrinsic() || patched.find(target) == patched.end()) {
+                    continue;
+                }
+                indirect_calls++;
+                if (target != callee && processed.find(target) == processed.end()) {
+                    auto [entry, added] = calls_per_callee.try_emplace(MapKey{target, target->getName().str()});
+                    entry->second.push_back(cloned);
+                    protected_functions += added;
+                    continue;
+                }
+                if (target == callee) {
+                    all_inlined = false;
+                } else if (unprotected.erase(target) != 0) {
+                    protected_functions++;
+                }
+            }
+        }
+
+        if (all_inlined) {
+            protected_functions--;
+            unprotected.insert(callee);
+        }
+
+        // The callee has to stay in the binary, as the set of functions
+        // collected before compiling needs to match the patched one.
+        llvm::appendToCompilerUsed(M, {callee});
+    }
+
+    *log << "Inlined " << inlined << " calls between patched functions, "
+         << "avoided " << initial_indirect_calls - indirect_calls << " indirect calls via the lookup table, "
+         << protected_functions << " distinct functions remain protected\n";
+
+    return inlined;
+}
@@ -1,5 +1,6 @@
 #include "PufPatcher.h"
 
+#include <stdexcept>
 #include <string>
 
 #include "llvm/Passes/PassPlugin.h"
@@ -7,9 +8,6 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
-// Keep this constant.
-const std::string replacement_file = "replacements.json";
-
 static llvm::cl::opt<std::string> FunctionsPrefix(
         "prefix",
         llvm::cl::desc("when specified it will only consider functions with the given prefix as entry points and any "
@@ -39,12 +37,119 @@ static llvm::cl::opt<std::string> InputFile(
         llvm::cl::Optional
 );
 
+static llvm::cl::opt<std::string> ReplacementsFile(
+        "replacementsjson",
+        llvm::cl::desc("Will output the replacements of the reference value markers for elf-parser"),
+        llvm::cl::value_desc("string"),
+        llvm::cl::Optional,
+        llvm::cl::init("replacements.json")
+);
+
+static llvm::cl::opt<PufLogLevel> LogLevel(
+        "puf-log-level",
+        llvm::cl::desc("logging performed by the PUF reader thread in the protected binary"),
+        llvm::cl::values(
+                clEnumValN(PufLogLevel::None, "none", "no logging, no stdio calls are emitted"),
+                clEnumValN(PufLogLevel::Stats, "stats", "count responses and failed reads in ____puf_stats____"),
+                clEnumValN(PufLogLevel::Debug, "debug", "print every response to stdout")
+        ),
+        llvm::cl::Optional,
+        llvm::cl::init(PufLogLevel::None)
+);
+
+static llvm::cl::opt<ReaderPolicy> ReaderSchedPolicy(
+        "puf-reader-policy",
+        llvm::cl::desc("scheduling policy of the PUF reader thread"),
+        llvm::cl::values(
+                clEnumValN(ReaderPolicy::Inherit, "inherit", "keep the policy of the creating thread"),
+                clEnumValN(ReaderPolicy::Batch, "batch", "SCHED_BATCH"),
+                clEnumValN(ReaderPolicy::Idle, "idle", "SCHED_IDLE, only runs when nothing else is runnable")
+        ),
+        llvm::cl::Optional,
+        llvm::cl::init(ReaderPolicy::Inherit)
+);
+
+static llvm::cl::opt<int32_t> ReaderNice(
+        "puf-reader-nice",
+        llvm::cl::desc("nice level of the PUF reader thread, 0 keeps the inherited one"),
+        llvm::cl::value_desc("number"),
+        llvm::cl::Optional,
+        llvm::cl::init(0)
+);
+
+static llvm::cl::opt<uint32_t> ReaderCpuMask(
+        "puf-reader-cpus",
+        llvm::cl::desc("mask of the CPUs the PUF reader thread may run on (bit N = CPU N), 0 keeps the inherited one"),
+        llvm::cl::value_desc("mask"),
+        llvm::cl::Optional,
+        llvm::cl::init(0)
+);
+
+static llvm::cl::opt<uint32_t> ReaderStackSize(
+        "puf-reader-stack-size",
+        llvm::cl::desc("stack size of the PUF reader thread in bytes, 0 keeps the libc default"),
+        llvm::cl::value_desc("bytes"),
+        llvm::cl::Optional,
+        llvm::cl::init(64 * 1024)
+);
+
+static llvm::cl::opt<ResponseMode> ResponseDelivery(
+        "puf-response-mode",
+        llvm::cl::desc("how the responses reach the gates of the protected binary"),
+        llvm::cl::values(
+                clEnumValN(ResponseMode::Read, "read", "a reader thread copies the responses returned by read()"),
+                clEnumValN(ResponseMode::Page, "page", "the gates load the responses from the mmap'ed response page "
+                                                       "of /dev/puf, no reader thread")
+        ),
+        llvm::cl::Optional,
+        llvm::cl::init(ResponseMode::Read)
+);
+
+static llvm::cl::opt<std::string> BrokerSocket(
+        "puf-broker",
+        llvm::cl::desc("unix socket of the PUF broker, the protected binary sends its enrollment to the broker "
+                       "instead of opening /dev/puf"),
+        llvm::cl::value_desc("path"),
+        llvm::cl::Optional
+);
+
+PufPatcherFiles command_line_files() {
+    return PufPatcherFiles{
+            .functions_out = OutputFile.getValue(),
+            .functions_in = InputFile.getValue(),
+            .replacements_out = ReplacementsFile.getValue(),
+    };
+}
+
 llvm::PreservedAnalyses PufPatcher::run(llvm::Module &M, llvm::ModuleAnalysisManager &AM) {
+    log_level = LogLevel.getValue();
+    if (!files) {
+        files = command_line_files();
+    }
+    checksum.name_tag = name_tag;
+
+    if (ReaderStackSize != 0 && ReaderStackSize < TARGET_PTHREAD_STACK_MIN) {
+        throw std::runtime_error("puf-reader-stack-size is smaller than PTHREAD_STACK_MIN");
+    }
+    reader_config = ReaderThreadConfig{
+            .policy = ReaderSchedPolicy.getValue(),
+            .nice = ReaderNice.getValue(),
+            .cpu_mask = ReaderCpuMask.getValue(),
+            .stack_size = ReaderStackSize.getValue(),
+    };
+    broker_path = BrokerSocket.getValue();
+    if (broker_path.size() >= TARGET_UNIX_PATH_MAX) {
+        throw std::runtime_error("puf-broker socket path is longer than the sun_path of sockaddr_un");
+    }
+    response_mode = ResponseDelivery.getValue();
+    if (response_mode == ResponseMode::Page && !broker_path.empty()) {
+        throw std::runtime_error("puf-response-mode=page needs /dev/puf, the broker has no response page");
+    }
     init_deps(M);
 
     // Store which functions are we considering in this LLVM pass
     // for double-checking which of the functions will be in the binary.
-    if (!OutputFile.empty()) {
+    if (!files->functions_out.empty()) {
         // collect functions for which we have definitions.
         // These are the function we will patch.
         std::vector<std::string> func_names;
@@ -54,38 +159,52 @@ llvm::PreservedAnalyses PufPatcher::run(llvm::Module &M, llvm::ModuleAnalysisMan
             }
             func_names.push_back(f.getName().str());
         }
-        crossover::write_func_requests(OutputFile, func_names);
+        crossover::write_func_requests(files->functions_out, func_names);
     }
 
     auto enrollments = crossover::read_enrollment_data(EnrollmentFile);
-    auto table = crossover::read_func_response(InputFile);
+    if (response_mode == ResponseMode::Page && enrollments.requests.size() > PUF_PAGE_MAX_WINDOWS) {
+        throw std::runtime_error("too many requested responses for the response page");
+    }
+    auto table = crossover::read_func_response(files->functions_in);
 
+    // the metadata may cover several modules, only the functions
+    // defined in this one are patched.
     std::vector<llvm::Function *> functions_to_patch;
     for (auto &f: M) {
-        if (table.find(f.getName().str()) != table.end()) {
+        if (!f.isDeclaration() && table.find(f.getName().str()) != table.end()) {
             functions_to_patch.push_back(&f);
         }
     }
-    // Analyse call graph before replacing with indirect calls and before adding
-    // PUF thread.
-    auto call_graph = llvm::CallGraphAnalysis().run(M, AM);
-
     // Find all external entry points into the IR module.
-    auto external_entry_points = find_all_external_entry_points(M, call_graph);
+    std::set<llvm::Function *> external_entry_points;
 
     std::vector<llvm::Function *> function_to_patch_filtered(functions_to_patch.begin(), functions_to_patch.end());
-    if (std::string prefix = FunctionsPrefix.getValue(); !prefix.empty()) {
-        auto [entry_points, filtered_functions] = collect_unique_calls_from_functions_with_prefix(
-                call_graph,
-                functions_to_patch,
-                prefix,
-                table,
-                external_entry_points
-        );
-        function_to_patch_filtered = std::move(filtered_functions);
-        external_entry_points = std::move(entry_points);
+    {
+        auto call_graph = llvm::CallGraphAnalysis().run(M, AM);
+        external_entry_points = find_all_external_entry_points(M, call_graph);
+
+        if (std::string prefix = FunctionsPrefix.getValue(); !prefix.empty()) {
+            auto [entry_points, filtered_functions] = collect_unique_calls_from_functions_with_prefix(
+                    call_graph,
+                    functions_to_patch,
+                    prefix,
+                    table,
+                    external_entry_points
+            );
+            function_to_patch_filtered = std::move(filtered_functions);
+            external_entry_points = std::move(entry_points);
+        }
     }
 
+    // Inline small callees among the functions that are patched, calls that
+    // disappear here will not end up as indirect calls via the lookup table.
+    inline_small_callees(M, function_to_patch_filtered);
+
+    // Analyse call graph before replacing with indirect calls and before adding
+    // PUF thread, once the inlined calls are gone.
+    auto call_graph = llvm::CallGraphAnalysis().run(M, AM);
+
     // Replaces all calls/invokes in the collected functions and creates a lookup table
     // where each function has it place which will be then computed when receiving the correct PUF response.
     // After this function only the call_graph should be used for identifying the calls.
@@ -106,7 +225,7 @@ llvm::PreservedAnalyses PufPatcher::run(llvm::Module &M, llvm::ModuleAnalysisMan
             external_entry_points
     );
 
-    // open the /dev/puf in a ctor
+    // open the /dev/puf (or connect to the broker) in a ctor
     // It will open the device, write the enrollment data to it.
     auto ctor = puf_open_ctor(M, enrollments, global_variables.puf_fd);
 
@@ -115,11 +234,14 @@ llvm::PreservedAnalyses PufPatcher::run(llvm::Module &M, llvm::ModuleAnalysisMan
 
     // add code that spawns a detached thread that will perform the PUF readings.
     // Function call added will not be in the lookup table created above, this is by design.
-    auto *puf_arr_offset_global = spawn_puf_thread(M, puf_array, ctor, enrollments);
+    // With the response page the gates read the responses themselves.
+    if (response_mode == ResponseMode::Read) {
+        spawn_puf_thread(M, puf_array, ctor, enrollments);
+    }
 
     // add checksums to each function that will be patched
     // in the binary.
-    checksum.run(M, functions_to_patch, puf_arr_offset_global);
+    checksum.run(M, functions_to_patch, global_variables.puf_arr_offset);
 
     return llvm::PreservedAnalyses::none();
 }
@@ -298,11 +420,11 @@ void PufPatcher::insert_address_calculations(
 
     // Debug Print collected information.
     for (auto &[external_func, paths_to_target_func]: mappings) {
-        llvm::outs() << "External entry: " << external_func.key << "\n";
+        *log << "External entry: " << external_func.key << "\n";
         for (auto &target_func: paths_to_target_func) {
-            llvm::outs() << "\tTarget Func: " << target_func.first.key << "\n";
+            *log << "\tTarget Func: " << target_func.first.key << "\n";
             for (auto &path: target_func.second) {
-                llvm::outs() << "\t\t" << path->getName().str() << "\n";
+                *log << "\t\t" << path->getName().str() << "\n";
             }
         }
     }
@@ -381,7 +503,7 @@ void PufPatcher::insert_address_calculations(
         // If they don't match, some of the inserted operations are not deterministic
         // and the compiler changes the compiled code in a non-deterministic way.
         for (auto &v: info) {
-            llvm::outs() << "Function: " << key.function->getName().str() << "\n"
+            *log << "Function: " << key.function->getName().str() << "\n"
                          << "\t" << "Spawn function: " << v.reference_value_marker.second << "\n"
                          << "\t" << "To access function: " << v.funcion_call_to_replace->getName().str() << "\n"
                          << "\t" << "Will use PUF: (idx) " << v.puff_arr_index << " (value) "
@@ -406,7 +528,7 @@ void PufPatcher::insert_address_calculations(
     }
 
     // create a JSON from the collected_replacement_info
-    crossover::write_replacements_requests(replacement_file, replacements);
+    crossover::write_replacements_requests(files->replacements_out, replacements);
 }
 
 void PufPatcher::generate_block_until_puf_response(
@@ -511,29 +633,36 @@ void PufPatcher::generate_block_until_puf_response(
     Builder.SetInsertPoint(loop_header_bb);
 
     // Load current index to wait on.
-    // puf_array[puf_offsets[offset_reader]]
-    auto puf_array_ptr = Builder.CreateInBoundsGEP(
-            puf_array.first->getValueType(),
-            puf_array.first,
-            {
-                    LLVM_CONST_I32(ctx, 0),
-                    Builder.CreateLoad(
-                            LLVM_I32(ctx),
-                            Builder.CreateInBoundsGEP(
-                                    puf_offsets_typ,
-                                    puf_offsets_ptr,
-                                    {
-                                            LLVM_CONST_I32(ctx, 0),
-                                            Builder.CreateLoad(LLVM_I32(ctx), offsets_reader_ptr)
-                                    }
-                            )
-                    )
-
-            }
+    auto *puf_arr_index = Builder.CreateLoad(
+            LLVM_I32(ctx),
+            Builder.CreateInBoundsGEP(
+                    puf_offsets_typ,
+                    puf_offsets_ptr,
+                    {
+                            LLVM_CONST_I32(ctx, 0),
+                            Builder.CreateLoad(LLVM_I32(ctx), offsets_reader_ptr)
+                    }
+            )
     );
 
-    // check if 0
-    auto condition = Builder.CreateICmpEQ(Builder.CreateLoad(LLVM_U32(ctx), puf_array_ptr), LLVM_CONST_I32(ctx, 0));
+    llvm::Value *puf_response = nullptr;
+    llvm::Value *condition = nullptr;
+    if (response_mode == ResponseMode::Page) {
+        auto [response, loaded] = load_page_response(Builder, puf_arr_index, puf_array.second);
+        puf_response = response;
+        condition = Builder.CreateNot(loaded);
+    } else {
+        // puf_array[puf_offsets[offset_reader]]
+        auto puf_array_ptr = Builder.CreateInBoundsGEP(
+                puf_array.first->getValueType(),
+                puf_array.first,
+                {LLVM_CONST_I32(ctx, 0), puf_arr_index}
+        );
+
+        // check if 0
+        puf_response = Builder.CreateLoad(LLVM_U32(ctx), puf_array_ptr);
+        condition = Builder.CreateICmpEQ(puf_response, LLVM_CONST_I32(ctx, 0));
+    }
     auto true_block = llvm::BasicBlock::Create(ctx, "puf_loaded", function_to_add_code, &function_entry_block);
     auto false_block = llvm::BasicBlock::Create(ctx, "puf_not_loaded", function_to_add_code, &function_entry_block);
     Builder.CreateCondBr(condition, false_block, true_block);
@@ -573,7 +702,7 @@ void PufPatcher::generate_block_until_puf_response(
     Builder.CreateStore(
             Builder.CreateAdd(
                     Builder.CreateAdd(
-                            Builder.CreateLoad(LLVM_U32(ctx), puf_array_ptr),
+                            puf_response,
                             Builder.CreateLoad(
                                     LLVM_U32(ctx),
                                     Builder.CreateInBoundsGEP(
@@ -610,11 +739,66 @@ void PufPatcher::generate_block_until_puf_response(
     assert(&function_to_add_code->getEntryBlock() == new_entry_block);
 }
 
+// Reads the response of the window at puf_arr_index from the response page, as the
+// reader thread would have stored it, returns the response and whether it is published.
+// seq = page[0] (acquire)
+// ready = page[2 + 2 * index] (acquire), response = page[3 + 2 * index]
+// fence acquire
+// loaded = ready && !(seq & 1) && seq == page[0]
+std::pair<llvm::Value *, llvm::Value *> PufPatcher::load_page_response(
+        llvm::IRBuilder<> &Builder,
+        llvm::Value *puf_arr_index,
+        size_t puf_array_size
+) {
+    auto &ctx = Builder.getContext();
+
+    auto load_word = [&](llvm::Value *page, llvm::Value *word, llvm::AtomicOrdering ordering) {
+        auto *load = Builder.CreateLoad(LLVM_I32(ctx), Builder.CreateInBoundsGEP(LLVM_I32(ctx), page, {word}));
+        load->setAtomic(ordering);
+        load->setAlignment(llvm::Align(sizeof(uint32_t)));
+        return load;
+    };
+
+    // the window is scaled by the offset as in the reader thread, out of range windows
+    // are never loaded, leaving the gates waiting on them blocked.
+    auto *window = Builder.CreateMul(
+            puf_arr_index,
+            Builder.CreateLoad(LLVM_I32(ctx), global_variables.puf_arr_offset)
+    );
+    auto *in_range = Builder.CreateICmpULT(window, LLVM_CONST_I32(ctx, puf_array_size));
+    window = Builder.CreateSelect(in_range, window, LLVM_CONST_I32(ctx, 0));
+
+    auto *page = Builder.CreateLoad(llvm::PointerType::getInt8PtrTy(ctx), global_variables.puf_page);
+    auto *ready_word = Builder.CreateAdd(
+            Builder.CreateShl(window, LLVM_CONST_I32(ctx, 1)),
+            LLVM_CONST_I32(ctx, PUF_PAGE_HEADER_WORDS)
+    );
+
+    auto *seq = load_word(page, LLVM_CONST_I32(ctx, 0), llvm::AtomicOrdering::Acquire);
+    auto *ready = load_word(page, ready_word, llvm::AtomicOrdering::Acquire);
+    auto *response = load_word(
+            page,
+            Builder.CreateAdd(ready_word, LLVM_CONST_I32(ctx, 1)),
+            llvm::AtomicOrdering::Monotonic
+    );
+    Builder.CreateFence(llvm::AtomicOrdering::Acquire);
+    auto *seq_after = load_word(page, LLVM_CONST_I32(ctx, 0), llvm::AtomicOrdering::Monotonic);
+
+    auto *loaded = Builder.CreateAnd(
+            Builder.CreateAnd(in_range, Builder.CreateICmpNE(ready, LLVM_CONST_I32(ctx, 0))),
+            Builder.CreateAnd(
+                    Builder.CreateICmpEQ(Builder.CreateAnd(seq, LLVM_CONST_I32(ctx, 1)), LLVM_CONST_I32(ctx, 0)),
+                    Builder.CreateICmpEQ(seq, seq_after)
+            )
+    );
+
+    return {response, loaded};
+}
+
 std::pair<llvm::GlobalVariable *, std::string> PufPatcher::generate_reference_value_asm(llvm::Module &M) {
-    static int i = 0;
     auto &ctx = M.getContext();
 
-    std::string function_name = "________rv_a" + std::to_string(i++);
+    std::string function_name = "________rv_a" + name_tag + std::to_string(reference_values++);
     std::string reference_label_name = function_name + "ref";
 
     llvm::Function *reference_value_function = llvm::Function::Create(
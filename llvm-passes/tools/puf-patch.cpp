@@ -0,0 +1,214 @@
+// Runs the PufPatcher pass over the bitcode files of a binary concurrently, the
+// multi-module counterpart of `opt -load-pass-plugin libPufPatcher -passes=pufpatcher`.
+//
+// Every module is patched in its own LLVMContext by a pool of -jobs threads. The function
+// metadata (-outputjson) and the replacements (-replacementsjson) of each module go to a
+// shard of their own (<file>.<index>), merged in the order of the sorted input paths once
+// all modules are patched, so that the merged files don't depend on the scheduling. The
+// names of the generated functions carry the index of their module and stay unique across
+// the binary. If -inputjson names the -outputjson file, each module is patched against its
+// own shard, as opt does when it is given the same file for both.
+//
+// usage: puf-patch [pass options] [-jobs N] [-output-dir DIR] [-S] <bitcode files...>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PufPatcher.h"
+#include "Crossover.h"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+static llvm::cl::list<std::string> InputFiles(
+        llvm::cl::Positional,
+        llvm::cl::desc("<bitcode files>"),
+        llvm::cl::OneOrMore
+);
+
+static llvm::cl::opt<unsigned> Jobs(
+        "jobs",
+        llvm::cl::desc("number of modules patched concurrently, 0 (default) uses all cores"),
+        llvm::cl::value_desc("number"),
+        llvm::cl::Optional,
+        llvm::cl::init(0)
+);
+
+static llvm::cl::alias JobsShort(
+        "j",
+        llvm::cl::desc("alias for -jobs"),
+        llvm::cl::aliasopt(Jobs)
+);
+
+static llvm::cl::opt<std::string> OutputDir(
+        "output-dir",
+        llvm::cl::desc("directory the patched modules are written to, they are patched in place if empty"),
+        llvm::cl::value_desc("path"),
+        llvm::cl::Optional
+);
+
+static llvm::cl::opt<bool> OutputAssembly(
+        "S",
+        llvm::cl::desc("write the patched modules as textual IR"),
+        llvm::cl::Optional,
+        llvm::cl::init(false)
+);
+
+struct ModuleJob {
+    std::string input;
+    std::string output;
+    PufPatcherFiles files;
+    // debug output of the pass, printed in the order of the inputs.
+    std::string log;
+    // empty if the module was patched.
+    std::string error;
+};
+
+static std::string shard_path(const std::string &file, size_t index) {
+    return file.empty() ? file : file + "." + std::to_string(index);
+}
+
+static void patch_module(ModuleJob &job, const std::string &name_tag) {
+    llvm::LLVMContext ctx;
+    llvm::SMDiagnostic diagnostic;
+    llvm::raw_string_ostream error(job.error);
+
+    std::unique_ptr<llvm::Module> M = llvm::parseIRFile(job.input, diagnostic, ctx);
+    if (!M) {
+        diagnostic.print("puf-patch", error);
+        return;
+    }
+
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+    llvm::PassBuilder PB;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::raw_string_ostream log(job.log);
+    PufPatcher patcher;
+    patcher.files = job.files;
+    patcher.name_tag = name_tag;
+    patcher.log = &log;
+
+    try {
+        patcher.run(*M, MAM);
+    } catch (const std::exception &e) {
+        error << e.what() << "\n";
+        return;
+    }
+
+    if (llvm::verifyModule(*M, &error)) {
+        return;
+    }
+
+    std::error_code ec;
+    llvm::ToolOutputFile out(
+            job.output,
+            ec,
+            OutputAssembly ? llvm::sys::fs::OF_TextWithCRLF : llvm::sys::fs::OF_None
+    );
+    if (ec) {
+        error << "failed to open " << job.output << ": " << ec.message() << "\n";
+        return;
+    }
+    if (OutputAssembly) {
+        M->print(out.os(), nullptr);
+    } else {
+        llvm::WriteBitcodeToFile(*M, out.os());
+    }
+    out.keep();
+}
+
+int main(int argc, char **argv) {
+    llvm::InitLLVM X(argc, argv);
+    llvm::cl::ParseCommandLineOptions(argc, argv, "patches the modules of a binary with the PufPatcher pass\n");
+
+    // the index of a module follows from its path, not from the order of the arguments.
+    std::vector<std::string> inputs(InputFiles.begin(), InputFiles.end());
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+    PufPatcherFiles files = command_line_files();
+    bool own_shard = !files.functions_in.empty() && files.functions_in == files.functions_out;
+
+    std::vector<ModuleJob> jobs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        jobs[i].input = inputs[i];
+        jobs[i].output = inputs[i];
+        if (!OutputDir.empty()) {
+            llvm::SmallString<256> output(OutputDir.getValue());
+            llvm::sys::path::append(output, llvm::sys::path::filename(inputs[i]));
+            jobs[i].output = output.str().str();
+        }
+        jobs[i].files = PufPatcherFiles{
+                .functions_out = shard_path(files.functions_out, i),
+                .functions_in = own_shard ? shard_path(files.functions_out, i) : files.functions_in,
+                .replacements_out = shard_path(files.replacements_out, i),
+        };
+    }
+
+    llvm::ThreadPool pool(llvm::hardware_concurrency(Jobs));
+    for (size_t i = 0; i < jobs.size(); i++) {
+        pool.async([&jobs, i] {
+            patch_module(jobs[i], std::to_string(i) + "_");
+        });
+    }
+    pool.wait();
+
+    uint32_t failed = 0;
+    std::vector<std::string> function_shards;
+    std::vector<std::string> replacement_shards;
+    for (auto &job: jobs) {
+        llvm::outs() << job.log;
+        if (!job.error.empty()) {
+            llvm::errs() << job.input << ": " << job.error;
+            failed++;
+        }
+        if (!job.files.functions_out.empty()) {
+            function_shards.push_back(job.files.functions_out);
+        }
+        replacement_shards.push_back(job.files.replacements_out);
+    }
+    if (failed != 0) {
+        llvm::errs() << "puf-patch: " << failed << " of " << jobs.size() << " modules failed\n";
+        return 1;
+    }
+
+    try {
+        if (!files.functions_out.empty()) {
+            crossover::merge_func_requests(files.functions_out, function_shards);
+        }
+        crossover::merge_replacements_requests(files.replacements_out, replacement_shards);
+    } catch (const std::exception &e) {
+        llvm::errs() << "puf-patch: failed to merge the shards: " << e.what() << "\n";
+        return 1;
+    }
+
+    for (auto &shard: function_shards) {
+        llvm::sys::fs::remove(shard);
+    }
+    for (auto &shard: replacement_shards) {
+        llvm::sys::fs::remove(shard);
+    }
+    return 0;
+}
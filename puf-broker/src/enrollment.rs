@@ -0,0 +1,312 @@
+use std::collections::HashMap;
+
+/// Version of the enrollment sets understood by the kernel module.
+pub const VERSION: u8 = 1;
+/// Version of the sets carrying the temperature their records were enrolled at.
+pub const VERSION_TEMP: u8 = 2;
+/// |(8bit)version|(8bit)flags|(16bit)record count| of each set.
+pub const SET_HEADER_SIZE: usize = 4;
+/// |(8bit)reference temperature|(8bit)halving| following the header of version 2 sets.
+pub const SET_TEMP_SIZE: usize = 2;
+/// Flag of the sets whose parity protects the 4 response bytes, with 8bit parity values.
+pub const FLAG_PACKED: u8 = 0x1;
+/// At most one parity symbol per response bit.
+const MAX_PARITY: usize = 32;
+/// Cells of a single 32bit response.
+const CELLS: usize = 32;
+
+/// A decay window record as written to /dev/puf, together with the header of its set.
+/// |(32bit) decay time in ms|(8bit) parity count|(16bit) parity|32 x (32bit) cell pointers|
+/// with (8bit) parity in packed sets.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct Record {
+    version: u8,
+    flags: u8,
+    /// header fields following the record count, the temperature of version 2 sets.
+    extension: Vec<u8>,
+    bytes: Vec<u8>,
+}
+
+impl Record {
+    /// Byte offsets of the cells in the PUF region, a cell pointer addresses the
+    /// bit (low 4 bits) of a 16bit block, the same way the kernel module reads it.
+    fn cells(&self) -> impl Iterator<Item = u64> + '_ {
+        self.bytes[self.bytes.len() - CELLS * 4..]
+            .chunks_exact(4)
+            .map(|ptr| (u32::from_be_bytes(ptr.try_into().unwrap()) >> 4) as u64 * 2)
+    }
+}
+
+/// Bytes of the PUF region spanned by the cells of the records, as (begin, end).
+pub fn cell_span(records: &[Record]) -> (u64, u64) {
+    records
+        .iter()
+        .flat_map(|r| r.cells())
+        .fold((u64::MAX, 0), |(begin, end), offset| (begin.min(offset), end.max(offset + 2)))
+}
+
+/// Enrollment of several clients merged into a single one.
+pub struct Merged {
+    /// Enrollment to be written to the device.
+    pub data: Vec<u8>,
+    /// For each window of the merged enrollment, the (client, window index of the client)
+    /// pairs waiting for its response.
+    pub targets: Vec<Vec<(usize, u32)>>,
+}
+
+/// Splits the enrollment sent by a client into its records, in the order of
+/// their window index. Validates the same way the kernel module does.
+pub fn parse(data: &[u8]) -> Result<Vec<Record>, String> {
+    let mut records = Vec::new();
+    let mut ptr = 0;
+
+    while ptr < data.len() {
+        if data.len() - ptr < SET_HEADER_SIZE {
+            return Err(format!("truncated set header at byte {}", ptr));
+        }
+        let (version, flags) = (data[ptr], data[ptr + 1]);
+        let extension_size = match version {
+            VERSION => 0,
+            VERSION_TEMP => SET_TEMP_SIZE,
+            _ => usize::MAX,
+        };
+        if extension_size == usize::MAX || flags & !FLAG_PACKED != 0x0 {
+            return Err(format!("unsupported set version {} flags {}", version, flags));
+        }
+        let count = u16::from_be_bytes([data[ptr + 2], data[ptr + 3]]) as usize;
+        if count == 0 {
+            return Err(format!("empty set at byte {}", ptr));
+        }
+        ptr += SET_HEADER_SIZE;
+        if data.len() - ptr < extension_size {
+            return Err(format!("truncated set header at byte {}", ptr));
+        }
+        let extension = data[ptr..ptr + extension_size].to_vec();
+        ptr += extension_size;
+
+        for _ in 0..count {
+            if data.len() - ptr < 5 {
+                return Err(format!("truncated record at byte {}", ptr));
+            }
+            let parity = data[ptr + 4] as usize;
+            if parity > MAX_PARITY {
+                return Err(format!("record at byte {} has {} parity symbols", ptr, parity));
+            }
+            let parity_size = if flags & FLAG_PACKED != 0x0 { 1 } else { 2 };
+            let size = 4 + 1 + parity * parity_size + CELLS * 4;
+            if data.len() - ptr < size {
+                return Err(format!("truncated record at byte {}", ptr));
+            }
+            records.push(Record {
+                version,
+                flags,
+                extension: extension.clone(),
+                bytes: data[ptr..ptr + size].to_vec(),
+            });
+            ptr += size;
+        }
+    }
+
+    if records.is_empty() {
+        return Err("empty enrollment".to_string());
+    }
+    Ok(records)
+}
+
+/// Merges the enrollments of the clients. Identical records (same decay time and cells,
+/// e.g. several instances of the same binary) are decayed once and their response is
+/// handed to every client enrolling them.
+pub fn merge<'a>(clients: impl Iterator<Item = &'a [Record]>) -> Merged {
+    let mut unique: Vec<&Record> = Vec::new();
+    let mut targets: Vec<Vec<(usize, u32)>> = Vec::new();
+    let mut index: HashMap<&Record, usize> = HashMap::new();
+
+    for (client, records) in clients.enumerate() {
+        for (local, record) in records.iter().enumerate() {
+            let window = *index.entry(record).or_insert_with(|| {
+                unique.push(record);
+                targets.push(Vec::new());
+                unique.len() - 1
+            });
+            targets[window].push((client, local as u32));
+        }
+    }
+
+    // records of the same set header are written as a single set (or several,
+    // if there are more than a set can hold), the window index of a record is
+    // its position across all sets.
+    let mut order: Vec<usize> = (0..unique.len()).collect();
+    order.sort_by_key(|&i| (unique[i].version, unique[i].flags, &unique[i].extension));
+
+    let mut data = Vec::new();
+    let mut header = 0;
+    let mut count: u16 = 0;
+    let mut previous: Option<&Record> = None;
+    for &i in order.iter() {
+        let record = unique[i];
+        let new_set = match previous {
+            None => true,
+            Some(p) => {
+                count == u16::MAX
+                    || (p.version, p.flags, &p.extension) != (record.version, record.flags, &record.extension)
+            }
+        };
+        previous = Some(record);
+        if new_set {
+            header = data.len();
+            count = 0;
+            data.extend_from_slice(&[record.version, record.flags, 0, 0]);
+            data.extend_from_slice(&record.extension);
+        }
+        count += 1;
+        data[header + 2..header + 4].copy_from_slice(&count.to_be_bytes());
+        data.extend_from_slice(&record.bytes);
+    }
+
+    Merged {
+        data,
+        targets: order.into_iter().map(|i| std::mem::take(&mut targets[i])).collect(),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A record decaying for ms, with parity symbols of parity_size bytes and
+    /// its cells in the 16bit blocks from cell on.
+    fn record(ms: u32, parity: u8, parity_size: usize, cell: u32) -> Vec<u8> {
+        let mut bytes = ms.to_be_bytes().to_vec();
+        bytes.push(parity);
+        bytes.resize(bytes.len() + parity as usize * parity_size, 0xa5);
+        for i in 0..CELLS as u32 {
+            bytes.extend_from_slice(&(((cell + i) << 4) | i % 16).to_be_bytes());
+        }
+        bytes
+    }
+
+    /// A set of the records, the extension following the header.
+    fn set(version: u8, flags: u8, extension: &[u8], records: &[Vec<u8>]) -> Vec<u8> {
+        let mut data = vec![version, flags];
+        data.extend_from_slice(&(records.len() as u16).to_be_bytes());
+        data.extend_from_slice(extension);
+        records.iter().for_each(|r| data.extend_from_slice(r));
+        data
+    }
+
+    /// Every target of every window of the merged enrollment is the record
+    /// the client enrolled at its local window index.
+    fn assert_targets(clients: &[Vec<Record>], merged: &Merged) {
+        let windows = parse(&merged.data).unwrap();
+        assert_eq!(windows.len(), merged.targets.len());
+        let mut seen = 0;
+        for (window, targets) in merged.targets.iter().enumerate() {
+            for &(client, local) in targets {
+                assert_eq!(windows[window], clients[client][local as usize]);
+                seen += 1;
+            }
+        }
+        assert_eq!(seen, clients.iter().map(|c| c.len()).sum::<usize>());
+    }
+
+    #[test]
+    fn parse_accepts_both_versions() {
+        let mut data = set(VERSION, 0, &[], &[record(100, 4, 2, 0), record(200, 0, 2, 64)]);
+        data.extend(set(VERSION_TEMP, FLAG_PACKED, &[40, 10], &[record(300, 8, 1, 128)]));
+
+        let records = parse(&data).unwrap();
+        assert_eq!(records.len(), 3);
+        assert_eq!(records[2].extension, vec![40, 10]);
+        assert_eq!(cell_span(&records), (0, (128 + CELLS as u64) * 2));
+    }
+
+    #[test]
+    fn parse_rejects_truncated_records() {
+        let data = set(VERSION, 0, &[], &[record(100, 4, 2, 0)]);
+        for len in 1..data.len() {
+            assert!(parse(&data[..len]).is_err(), "accepted {} of {} bytes", len, data.len());
+        }
+
+        // the packed parity of a record in an unpacked set.
+        let data = set(VERSION, 0, &[], &[record(100, 4, 1, 0)]);
+        assert!(parse(&data).is_err());
+        // a version 2 set without its temperature.
+        assert!(parse(&[VERSION_TEMP, 0, 0, 1, 40]).is_err());
+        assert!(parse(&[]).is_err());
+    }
+
+    #[test]
+    fn parse_rejects_unknown_headers() {
+        let records = [record(100, 0, 2, 0)];
+        assert!(parse(&set(0, 0, &[], &records)).is_err());
+        assert!(parse(&set(VERSION_TEMP + 1, 0, &[40, 10], &records)).is_err());
+        assert!(parse(&set(VERSION, 0x2, &[], &records)).is_err());
+        assert!(parse(&set(VERSION, FLAG_PACKED | 0x80, &[], &records)).is_err());
+        assert!(parse(&set(VERSION, 0, &[], &[])).is_err());
+    }
+
+    #[test]
+    fn parse_rejects_parity_above_the_bound() {
+        assert!(parse(&set(VERSION, 0, &[], &[record(100, MAX_PARITY as u8, 2, 0)])).is_ok());
+        assert!(parse(&set(VERSION, 0, &[], &[record(100, MAX_PARITY as u8 + 1, 2, 0)])).is_err());
+        assert!(parse(&set(VERSION, FLAG_PACKED, &[], &[record(100, MAX_PARITY as u8 + 1, 1, 0)])).is_err());
+    }
+
+    #[test]
+    fn merge_keeps_the_headers_apart() {
+        let shared = record(100, 4, 2, 0);
+        let clients = vec![
+            parse(&set(VERSION, 0, &[], &[shared.clone(), record(200, 4, 2, 64)])).unwrap(),
+            parse(&set(VERSION_TEMP, FLAG_PACKED, &[40, 10], &[record(300, 8, 1, 128), record(100, 4, 1, 0)]))
+                .unwrap(),
+            parse(&set(VERSION_TEMP, 0, &[45, 10], &[shared.clone()])).unwrap(),
+            parse(&set(VERSION, 0, &[], &[shared])).unwrap(),
+        ];
+
+        let merged = merge_clients(&clients);
+        // the shared record of the version 1 clients is decayed once, the one of
+        // the version 2 client carries another temperature.
+        assert_eq!(merged.targets.len(), 5);
+        assert_eq!(merged.targets.iter().filter(|t| t.len() == 2).count(), 1);
+        assert_targets(&clients, &merged);
+
+        // one set per header.
+        let headers: Vec<(u8, u8, Vec<u8>)> = set_headers(parse(&merged.data).unwrap());
+        assert_eq!(headers.len(), 3);
+    }
+
+    #[test]
+    fn merge_splits_sets_above_u16_max() {
+        let per_client = 40000;
+        let clients: Vec<Vec<Record>> = (0..2)
+            .map(|c| {
+                let records: Vec<Vec<u8>> = (0..per_client).map(|i| record(c * per_client + i, 0, 2, i)).collect();
+                let mut data = Vec::new();
+                for chunk in records.chunks(u16::MAX as usize) {
+                    data.extend(set(VERSION, 0, &[], chunk));
+                }
+                parse(&data).unwrap()
+            })
+            .collect();
+
+        let merged = merge_clients(&clients);
+        assert_eq!(merged.targets.len(), 2 * per_client as usize);
+        assert_eq!(u16::from_be_bytes([merged.data[2], merged.data[3]]), u16::MAX);
+        assert_targets(&clients, &merged);
+    }
+
+    fn merge_clients(clients: &[Vec<Record>]) -> Merged {
+        merge(clients.iter().map(|c| &c[..]))
+    }
+
+    fn set_headers(records: Vec<Record>) -> Vec<(u8, u8, Vec<u8>)> {
+        let mut headers: Vec<(u8, u8, Vec<u8>)> = Vec::new();
+        for r in records {
+            let header = (r.version, r.flags, r.extension);
+            if headers.last() != Some(&header) {
+                headers.push(header);
+            }
+        }
+        headers
+    }
+}
@@ -0,0 +1,313 @@
+mod enrollment;
+
+use enrollment::Record;
+use std::collections::BTreeMap;
+use std::env;
+use std::fs::{self, OpenOptions};
+use std::io::{self, Read, Write};
+use std::net::Shutdown;
+use std::os::unix::fs::{chown, PermissionsExt};
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::sync::mpsc::{self, Receiver, RecvTimeoutError};
+use std::thread;
+use std::time::{Duration, Instant};
+
+/// Upper bound of the enrollment a single client may send.
+const MAX_ENROLLMENT_BYTES: u64 = 16 << 20;
+/// A client has to send its whole enrollment within this time.
+const ENROLLMENT_TIMEOUT: Duration = Duration::from_secs(10);
+/// A client not taking its responses within this time is dropped, so that it
+/// does not hold up the delivery to the other clients of its session.
+const RESPONSE_TIMEOUT: Duration = Duration::from_secs(1);
+/// Size of a (32bit) window index, (32bit) response pair.
+const RESPONSE_SIZE: usize = 8;
+/// Parameters of the loaded kernel module, the slot size is derived from them.
+const MODULE_PARAMETERS: &str = "/sys/module/dram_puf/parameters";
+
+#[derive(Debug, Clone)]
+pub struct Config {
+    /// Unix socket the protected binaries connect to (-puf-broker of the LLVM pass).
+    pub socket: String,
+    /// PUF device owned by the broker.
+    pub device: String,
+    /// Clients connecting within this time after the first one are decayed together.
+    pub batch: Duration,
+    /// Bytes of each slot of the device (puf_size / puf_slots of the kernel module),
+    /// read from the parameters of the loaded module unless given.
+    pub slot_bytes: u64,
+    /// Permissions of the socket, whoever may connect receives the responses.
+    pub mode: u32,
+    /// Group (name or gid) owning the socket, the group of the broker if not set.
+    pub group: Option<String>,
+}
+
+impl Config {
+    pub fn new(mut args: env::Args) -> Result<Config, Box<dyn std::error::Error>> {
+        let usage = "usage: puf-broker <socket> [--device /dev/puf] [--batch-ms 500] [--slot-bytes n] [--mode 0660] [--group name]";
+        let socket = args.nth(1).ok_or(usage)?;
+
+        let mut cfg = Config {
+            socket,
+            device: "/dev/puf".to_string(),
+            batch: Duration::from_millis(500),
+            slot_bytes: 0,
+            mode: 0o660,
+            group: None,
+        };
+        let mut slot_bytes = None;
+
+        while let Some(arg) = args.next() {
+            let value = args.next().ok_or(usage)?;
+            match arg.as_str() {
+                "--device" => cfg.device = value,
+                "--batch-ms" => cfg.batch = Duration::from_millis(value.parse()?),
+                "--slot-bytes" => slot_bytes = Some(value.parse()?),
+                "--mode" => cfg.mode = u32::from_str_radix(&value, 8)?,
+                "--group" => cfg.group = Some(value),
+                _ => Err(usage)?,
+            }
+        }
+
+        // clients of different slots must never be merged, so the broker does
+        // not start without knowing the slot size.
+        cfg.slot_bytes = match slot_bytes {
+            Some(bytes) => bytes,
+            None => module_slot_bytes().map_err(|err| {
+                format!("cannot read the slot size from {} ({}), pass --slot-bytes", MODULE_PARAMETERS, err)
+            })?,
+        };
+        if cfg.slot_bytes == 0 {
+            Err("--slot-bytes needs to be non-zero")?;
+        }
+
+        Ok(cfg)
+    }
+}
+
+/// Slot size of the loaded kernel module, puf_size / puf_slots.
+fn module_slot_bytes() -> Result<u64, Box<dyn std::error::Error>> {
+    let param = |name: &str| -> Result<u64, Box<dyn std::error::Error>> {
+        Ok(fs::read_to_string(format!("{}/{}", MODULE_PARAMETERS, name))?.trim().parse()?)
+    };
+
+    let size = param("puf_size")?;
+    let slots = param("puf_slots")?;
+    if size == 0 || slots == 0 {
+        Err("module loaded without puf_size or puf_slots")?;
+    }
+
+    Ok(size / slots)
+}
+
+/// A protected process waiting for its responses.
+struct Client {
+    stream: UnixStream,
+    records: Vec<Record>,
+    /// responses not delivered yet.
+    remaining: usize,
+    /// the client went away, its responses are dropped.
+    gone: bool,
+}
+
+/// Accepts the protected processes on the socket. Each of them sends its enrollment
+/// (the same bytes it would write to /dev/puf) and shuts down its side of the connection,
+/// then reads its (window index, response) pairs the same way as from the device until
+/// the broker closes the connection.
+pub fn serve(cfg: &Config) -> io::Result<()> {
+    let listener = bind(cfg)?;
+
+    let (tx, rx) = mpsc::channel();
+    let scheduler_cfg = cfg.clone();
+    thread::spawn(move || schedule(&scheduler_cfg, rx));
+
+    for stream in listener.incoming() {
+        let stream = match stream {
+            Ok(stream) => stream,
+            Err(err) => {
+                eprintln!("failed to accept client: {}", err);
+                continue;
+            }
+        };
+
+        // a slow client must not hold up the others.
+        let tx = tx.clone();
+        thread::spawn(move || match receive(stream) {
+            Ok(client) => {
+                let _ = tx.send(client);
+            }
+            Err(err) => eprintln!("rejected client: {}", err),
+        });
+    }
+
+    Ok(())
+}
+
+/// Binds the socket with the configured mode and group. The socket is bound under
+/// a temporary name and only moved in place once both are set, as bind creates it
+/// with the permissions left by the umask.
+fn bind(cfg: &Config) -> io::Result<UnixListener> {
+    let staging = format!("{}.{}", cfg.socket, std::process::id());
+    // sockets left over by a previous run.
+    let _ = fs::remove_file(&cfg.socket);
+    let _ = fs::remove_file(&staging);
+
+    let listener = UnixListener::bind(&staging)?;
+    let restricted = fs::set_permissions(&staging, fs::Permissions::from_mode(cfg.mode))
+        .and_then(|_| match &cfg.group {
+            Some(group) => chown(&staging, None, Some(group_id(group)?)),
+            None => Ok(()),
+        })
+        .and_then(|_| fs::rename(&staging, &cfg.socket));
+    if let Err(err) = restricted {
+        let _ = fs::remove_file(&staging);
+        return Err(err);
+    }
+
+    Ok(listener)
+}
+
+/// Gid of the group, looked up by name in /etc/group unless it is numeric.
+fn group_id(group: &str) -> io::Result<u32> {
+    if let Ok(gid) = group.parse() {
+        return Ok(gid);
+    }
+
+    fs::read_to_string("/etc/group")?
+        .lines()
+        .map(|line| line.split(':').collect::<Vec<_>>())
+        .find(|fields| fields.len() > 2 && fields[0] == group)
+        .and_then(|fields| fields[2].parse().ok())
+        .ok_or_else(|| io::Error::new(io::ErrorKind::NotFound, format!("unknown group {}", group)))
+}
+
+fn receive(mut stream: UnixStream) -> Result<Client, Box<dyn std::error::Error>> {
+    stream.set_read_timeout(Some(ENROLLMENT_TIMEOUT))?;
+
+    let mut data = Vec::new();
+    (&mut stream).take(MAX_ENROLLMENT_BYTES).read_to_end(&mut data)?;
+    let records = enrollment::parse(&data)?;
+
+    stream.set_read_timeout(None)?;
+    stream.set_write_timeout(Some(RESPONSE_TIMEOUT))?;
+    Ok(Client {
+        stream,
+        remaining: records.len(),
+        records,
+        gone: false,
+    })
+}
+
+/// Collects the clients into batches, a batch starts with the first client waiting
+/// and takes every client arriving within the batch time. The clients connecting
+/// while a batch decays are taken by the next one.
+fn schedule(cfg: &Config, rx: Receiver<Client>) {
+    while let Ok(first) = rx.recv() {
+        let mut batch = vec![first];
+        let deadline = Instant::now() + cfg.batch;
+
+        while let Some(left) = deadline.checked_duration_since(Instant::now()) {
+            match rx.recv_timeout(left) {
+                Ok(client) => batch.push(client),
+                Err(RecvTimeoutError::Timeout) | Err(RecvTimeoutError::Disconnected) => break,
+            }
+        }
+
+        // the slots decay side by side, each in a session of its own.
+        let started = Instant::now();
+        thread::scope(|scope| {
+            for (slot, mut group) in group_by_slot(cfg, batch) {
+                scope.spawn(move || {
+                    let clients = group.len();
+                    match decay(cfg, &mut group) {
+                        Ok(windows) => println!(
+                            "batch of {} clients ({} windows) on slot {} done in {:?}",
+                            clients,
+                            windows,
+                            slot,
+                            started.elapsed()
+                        ),
+                        Err(err) => eprintln!("batch of {} clients on slot {} failed: {}", clients, slot, err),
+                    }
+                    // dropping the clients closes their connections, a client whose
+                    // windows were not all delivered reads 0 as if the device failed.
+                });
+            }
+        });
+    }
+}
+
+/// Splits the batch into the clients of each slot, the kernel module binds a session
+/// to the slot holding all of its cells, so merging enrollments of different slots
+/// would fail. A client whose cells span several slots is dropped, as the device would.
+fn group_by_slot(cfg: &Config, batch: Vec<Client>) -> BTreeMap<u64, Vec<Client>> {
+    let mut groups: BTreeMap<u64, Vec<Client>> = BTreeMap::new();
+
+    for client in batch {
+        let (begin, end) = enrollment::cell_span(&client.records);
+        let slot = begin / cfg.slot_bytes;
+        if end > (slot + 1) * cfg.slot_bytes {
+            eprintln!("rejected client: enrollment cells span more than a single slot");
+            continue;
+        }
+        groups.entry(slot).or_default().push(client);
+    }
+
+    groups
+}
+
+/// Decays the merged enrollment of the clients in a single session of the device
+/// and fans the responses out as they become ready.
+fn decay(cfg: &Config, clients: &mut [Client]) -> io::Result<usize> {
+    let merged = enrollment::merge(clients.iter().map(|c| &c.records[..]));
+    let windows = merged.targets.len();
+
+    let mut device = OpenOptions::new().read(true).write(true).open(&cfg.device)?;
+    // the device takes the enrollment in a single write.
+    if device.write(&merged.data)? != merged.data.len() {
+        return Err(io::Error::new(io::ErrorKind::WriteZero, "short enrollment write"));
+    }
+
+    let mut buf = vec![0u8; windows * RESPONSE_SIZE];
+    let mut out: Vec<Vec<u8>> = vec![Vec::new(); clients.len()];
+    let mut pending = windows;
+
+    while pending > 0 {
+        let n = device.read(&mut buf)?;
+        if n == 0 {
+            break;
+        }
+
+        for pair in buf[..n].chunks_exact(RESPONSE_SIZE) {
+            let index = u32::from_ne_bytes(pair[0..4].try_into().unwrap()) as usize;
+            let Some(targets) = merged.targets.get(index) else {
+                continue;
+            };
+            for &(client, local) in targets {
+                out[client].extend_from_slice(&local.to_ne_bytes());
+                out[client].extend_from_slice(&pair[4..8]);
+            }
+            pending -= 1;
+        }
+
+        // all pairs of a read go out in a single write, so that the client
+        // never reads a partial pair.
+        for (client, pairs) in clients.iter_mut().zip(out.iter_mut()) {
+            if pairs.is_empty() {
+                continue;
+            }
+            client.remaining -= pairs.len() / RESPONSE_SIZE;
+            // a timed out write may have left a partial pair, the client is
+            // disconnected so that it reads 0 instead of the rest of the pair.
+            if !client.gone && client.stream.write_all(pairs).is_err() {
+                client.gone = true;
+                let _ = client.stream.shutdown(Shutdown::Both);
+            }
+            if client.remaining == 0 {
+                let _ = client.stream.shutdown(Shutdown::Both);
+            }
+            pairs.clear();
+        }
+    }
+
+    Ok(windows)
+}
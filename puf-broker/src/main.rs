@@ -0,0 +1,16 @@
+use std::env;
+use std::process;
+
+use puf_broker::Config;
+
+fn main() {
+    let config = Config::new(env::args()).unwrap_or_else(|err| {
+        eprintln!("Problem parsing arguments: {}", err);
+        process::exit(1);
+    });
+
+    if let Err(err) = puf_broker::serve(&config) {
+        eprintln!("PUF broker failed: {}", err);
+        process::exit(1);
+    }
+}